@@ -0,0 +1,86 @@
+#ifndef DRIVER_CACHE
+#define DRIVER_CACHE
+
+#include "mc/MCFragment.hpp"
+#include "utils/ADT/StringRef.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace driver {
+using StringRef = utils::ADT::StringRef;
+
+/// on-disk, content-addressed store of assembled objects
+///
+///   <dir>/objects/<2 hex>/<30 hex>.o     one entry per key
+///   <dir>/fragments/<2 hex>/<30 hex>     .text of single functions
+///   <dir>/tmp/                           staging, renamed into place
+///   <dir>/stats                          hit/miss counters
+///
+/// a key covers the source bytes, the assembler binary and the flags, an
+/// entry never changes once published (the driver keeps sources that
+/// .incbin other files out of the cache). An input that misses as a whole
+/// still reuses the fragments of its unchanged functions. Several processes
+/// may share a cache: entries appear with an atomic link, counters are
+/// updated under flock, and entries are evicted least recently used first
+/// (every hit touches the entry's mtime) once the cache outgrows its size
+/// limit. Cache failures never fail the build, they just read as misses.
+class ObjectCache : public mc::FragmentCache {
+public:
+  using size_ty = std::size_t;
+
+  struct Stats {
+    std::uint64_t Hits = 0;
+    std::uint64_t Misses = 0;
+    std::uint64_t Entries = 0;
+    std::uint64_t Bytes = 0;
+  };
+
+private:
+  std::string Dir;
+  size_ty MaxSize;
+
+  std::string entryPath(StringRef Key) const;
+  std::string fragmentPath(StringRef Source, unsigned Align) const;
+
+  /// bytes of the entries published since the counters were last updated
+  std::atomic<std::uint64_t> Unrecorded = 0;
+
+  void record(bool Hit);
+
+  /// stage `Bytes` and link them to `Entry` unless it exists already
+  void publish(const std::string& Entry, StringRef Bytes);
+
+public:
+  explicit ObjectCache(std::string _Dir, size_ty _MaxSize = size_ty(1) << 30);
+
+  ~ObjectCache() override { flush(); }
+
+  /// 128-bit hex key of `Source` assembled with `Flags`
+  std::string key(StringRef Source, StringRef Flags = "") const;
+
+  /// hardlink (or copy) the entry of `Key` to `Output`, false on a miss
+  bool fetch(StringRef Key, const char* Output);
+
+  /// publish `Object` under `Key`
+  void store(StringRef Key, StringRef Object);
+
+  bool lookup(StringRef Source, unsigned Align,
+              std::string& Fragment) override;
+
+  void insert(StringRef Source, unsigned Align, StringRef Fragment) override;
+
+  /// add what was published since to the counters, once per job rather
+  /// than per entry; trims when the cache outgrew its limit
+  void flush();
+
+  /// evict least recently used entries until at most `MaxSize` bytes remain
+  void trim();
+
+  Stats stats() const;
+};
+
+} // namespace driver
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef DRIVER_DAEMON
+#define DRIVER_DAEMON
+
+namespace driver {
+
+/// serve assemble requests (see driver/Protocol.hpp) on `SocketPath` until
+/// killed, each connection on a thread of its own (a bounded number at
+/// once, the rest wait to be accepted); large requests spread
+/// their work over a pool of `ThreadNr` workers (0: one per core)
+/// only processes of the daemon's own user are served, they name the files
+/// it reads and writes
+/// every request owns its Lexer, Parser and MCContext, the opcode/register
+/// tables are initialized once for the process and shared read-only
+[[noreturn]] void serve(const char* SocketPath, unsigned ThreadNr = 0);
+
+} // namespace driver
+
+#endif
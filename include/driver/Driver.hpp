@@ -0,0 +1,83 @@
+#ifndef DRIVER_DRIVER
+#define DRIVER_DRIVER
+
+#include "driver/Cache.hpp"
+#include "utils/ADT/StringRef.hpp"
+#include "utils/IoQueue.hpp"
+#include "utils/ThreadPool.hpp"
+#include "utils/output.hpp"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace parser {
+class Lexer;
+} // namespace parser
+
+namespace driver {
+using StringRef = utils::ADT::StringRef;
+
+/// object size -> the buffer the object is emitted into
+using OpenOutput = std::function<utils::OutputBuffer(std::size_t)>;
+
+/// assemble everything `Lexer` yields with a fresh Parser and MCContext,
+/// returns the filled, not yet committed output
+/// functions found in `Fragments` are replayed rather than parsed
+/// with `StreamText` (always for a streaming Lexer) .text is encoded as it
+/// is parsed, memory doesn't grow with the program
+/// (MCContext::streamText()), `Fragments` is left alone then
+/// relative .incbin paths start at `IncludeDir` (empty: the working
+/// directory), `IncludesFiles` is set when an .incbin was emitted
+utils::OutputBuffer assemble(parser::Lexer& Lexer, const OpenOutput& Open,
+                             utils::ThreadPool* Pool = nullptr,
+                             mc::FragmentCache* Fragments = nullptr,
+                             bool StreamText = false,
+                             StringRef IncludeDir = "",
+                             bool* IncludesFiles = nullptr);
+
+/// one translation unit: `Input` assembled into `Output`, "-" names
+/// stdin/stdout
+struct Job {
+  std::string Input;
+  std::string Output;
+};
+
+/// assemble a single file, every call owns its Lexer, Parser and MCContext
+/// stdin is lexed incrementally instead of being slurped first, it and
+/// huge files stream their .text
+/// the functions of large sources are parsed and sections of large objects
+/// are filled on `Pool` (or a private one)
+/// with a `Cache`, unchanged inputs are served from it without assembling,
+/// changed ones only parse and encode the functions that changed; inputs
+/// that .incbin other files are always assembled
+/// relative .incbin paths start at the directory of the input
+void assemble(const Job& job, utils::ThreadPool* Pool = nullptr,
+              ObjectCache* Cache = nullptr);
+
+/// requests a batch keeps in flight on its utils::IoQueue
+constexpr unsigned DefaultIoDepth = 16;
+
+/// assemble all jobs concurrently on a work-stealing pool of `ThreadNr`
+/// workers (0: one per core), objects are byte-identical to serial runs
+/// the sources of upcoming jobs are read ahead and finished objects are
+/// written behind on a utils::IoQueue of `IoDepth`, so workers only block
+/// on disk when a source is late; 0 maps the files into the workers instead
+/// returns the I/O statistics of the run
+utils::IoQueue::Stats assembleBatch(const std::vector<Job>& jobs,
+                                    unsigned ThreadNr = 0,
+                                    ObjectCache* Cache = nullptr,
+                                    unsigned IoDepth = DefaultIoDepth);
+
+/// `<dir>/<stem of Input>.o`
+std::string objectPathIn(StringRef Dir, StringRef Input);
+
+/// the directory `Input` sits in, empty for the working directory
+std::string directoryOf(StringRef Input);
+
+/// response file: one `<input> <output>` pair per line, '#' starts a comment
+std::vector<Job> readResponseFile(const char* Path);
+
+} // namespace driver
+
+#endif
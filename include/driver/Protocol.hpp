@@ -0,0 +1,42 @@
+#ifndef DRIVER_PROTOCOL
+#define DRIVER_PROTOCOL
+
+#include "utils/ADT/StringRef.hpp"
+#include <cstddef>
+#include <string>
+
+/// wire format between `assembler --daemon` and `assembler-client`, one
+/// request per connection, every field is a frame: u64 length + bytes
+///
+///   client -> daemon: [input path] [output path] (source)
+///   daemon -> client: [status] [object]
+///
+/// paths are absolute, "-" as input means the source follows raw until
+/// the client shuts down its writing side, "-" as output means the object
+/// comes back in [object] (empty otherwise). [status] is empty on success.
+
+namespace driver {
+namespace protocol {
+using StringRef = utils::ADT::StringRef;
+
+/// $RVASM_SOCKET, or a per-user socket in /tmp
+std::string defaultSocketPath();
+
+/// connected socket, -1 when no daemon listens on `Path`
+int connectTo(const char* Path);
+
+/// listening socket bound to `Path`, a stale socket file is replaced;
+/// fails when a daemon still answers on it
+int listenOn(const char* Path);
+
+/// false once the peer is gone
+bool sendAll(int Fd, const void* Data, std::size_t Size);
+bool recvAll(int Fd, void* Data, std::size_t Size);
+
+bool sendFrame(int Fd, StringRef Data);
+bool recvFrame(int Fd, std::string& Data);
+
+} // namespace protocol
+} // namespace driver
+
+#endif
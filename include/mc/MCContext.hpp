@@ -8,14 +8,20 @@
 #include "utils/ADT/StringMap.hpp"
 #include "utils/ADT/StringRef.hpp"
 #include "utils/ADT/StringSet.hpp"
+#include "utils/ThreadPool.hpp"
 #include "utils/macro.hpp"
+#include "utils/spill.hpp"
 #include <cstddef>
 #include <deque>
 #include <elf.h>
 #include <fstream>
+#include <optional>
 #include <ostream>
 #include <set>
 #include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
 
 namespace mc {
 using StringRef = utils::ADT::StringRef;
@@ -29,14 +35,16 @@ public:
   using size_ty = std::size_t;
 
 private:
-  /// fs handle
-  std::ostream& file;
+  /// fs handle, none when the caller drives layout()/emit() itself
+  std::ostream* file = nullptr;
 
   /// inst use symbols, which need gen Elf64_Rela or cul offset(.text)
-  std::set<std::tuple<MCInst*, std::string>> ReloInst;
+  /// kept in program order: ordering by MCInst* depends on the heap layout,
+  /// which differs between threads and would reorder .rela.text/.strtab
+  std::vector<std::tuple<MCInst*, std::string>> ReloInst;
 
   /// ELF Header
-  Elf64_Ehdr Elf_Ehdr;
+  Elf64_Ehdr Elf_Ehdr{};
 
   /// .text
   size_ty TextOffset = 0;
@@ -45,6 +53,41 @@ private:
   std::deque<MCInst> Insts; // avoid realloction
   std::deque<MCExpr> Exprs; // avoid realloction
 
+  /// created by newTextInst() and not committed yet
+  size_ty OpenInsts = 0;
+
+  /// streamText(): the encoded .text, Insts and Exprs only hold what the
+  /// current statement added
+  std::optional<utils::SpillBuffer> TextBuffer;
+
+  /// a streamed branch/jump to a label not defined yet, encoded into its
+  /// place in TextBuffer once it is
+  struct Fixup {
+    size_ty Position;
+    MCInst Inst;
+    MCExpr Expr;
+  };
+  std::unordered_map<std::string, std::vector<Fixup>> Fixups;
+
+  /// relocations of streamed insts, in program order, see Relo()
+  struct StreamedRelo {
+    size_ty Offset;
+    uint64_t Addend;
+    uint32_t Sym; // into ReloSyms
+    uint32_t Type;
+    bool Relaxable;
+  };
+  std::vector<StreamedRelo> StreamedRelos;
+  /// symbols StreamedRelos name, in order of appearance
+  std::vector<std::string> ReloSyms;
+  std::unordered_map<std::string, uint32_t> ReloSymIndex;
+
+  /// encode the committed insts into TextBuffer, their relocations into
+  /// StreamedRelos, and let them go
+  void flushText();
+  /// `Label` was just defined at `Offset`, patch the fixups waiting for it
+  void resolveFixups(StringRef Label, size_ty Offset);
+
   /// .rela.text
 
 public:
@@ -66,6 +109,8 @@ private:
   /// .data
   StringMap<size_ty> DataVariables;
   ByteStream DataBuffer;
+  /// set once an .incbin copied another file into DataBuffer
+  bool IncludesFiles = false;
 
   /// .bss
   StringMap<size_ty> BssVariables;
@@ -83,8 +128,18 @@ private:
   /// Section Header Table
   SmallVector<Elf64_Shdr, 8> Elf_Shdrs;
 
+  /// where the function being recorded began, see beginFragment()
+  struct FragmentMark {
+    size_ty Insts, Relos, Labels, TextOffset, InnerLabelNr;
+    size_ty DataSize, DataVars, BssSize, BssVars;
+    std::vector<std::tuple<std::string, size_ty, NdxSection>> Symbols;
+    bool Cacheable = true;
+  };
+  std::optional<FragmentMark> Recording;
+
 public:
-  MCContext(std::ofstream& _file) : file(_file) {}
+  MCContext() = default;
+  MCContext(std::ostream& _file) : file(&_file) {}
   MCContext(const MCContext&) = delete;
   MCContext(MCContext&&) = delete;
   MCContext& operator=(const MCContext&) = delete;
@@ -112,6 +167,21 @@ private:
   }
 
 public:
+  /// encode .text as it is committed instead of holding every MCInst and
+  /// MCExpr until layout(), the bytes spill to a temporary file once they
+  /// outgrow `Limit`; only branches/jumps to labels not defined yet wait
+  /// (as fixups), memory is bound by them rather than by the program
+  /// call before anything is added, fragments can't be recorded after
+  void streamText(size_ty Limit = size_ty(64) << 20);
+
+  /// build sections and headers, returns the size of the object file
+  size_ty layout();
+
+  /// copy the laid out object into `Image`, layout() zeroed bytes long
+  /// sections (and slices of .text) are disjoint, with a `Pool` they are
+  /// filled concurrently
+  void emit(char* Image, utils::ThreadPool* Pool = nullptr) const;
+
   /// build obj file
   void writein();
 
@@ -124,18 +194,16 @@ public:
   /// add local symbols from .data .text .bss
   bool addReloSym(StringRef Str, size_ty offset, NdxSection ndx);
 
-  bool getTextOffset() const { return TextOffset; }
+  size_ty getTextOffset() const { return TextOffset; }
 
   size_ty addTextInst(MCInst&& inst);
 
-  MCInst* newTextInst(const StringRef OpCode LIFETIME_BOUND);
-
   MCInst* newTextInst(const MCOpCode* OpCode LIFETIME_BOUND);
 
   size_ty commitTextInst();
 
   template <std::size_t N>
-  MCInstPtrs newTextInsts(const SmallVector<StringRef, N>& Ops) {
+  MCInstPtrs newTextInsts(const SmallVector<const MCOpCode*, N>& Ops) {
     MCInstPtrs insts{};
 
     for (auto& op : Ops) {
@@ -155,6 +223,19 @@ public:
 
   size_ty commitTextInsts(const MCInstPtrs& insts);
 
+  /// record everything .text gains from here on: insts (pre-encoded unless
+  /// patched by Relo()), labels, global symbols and relocations
+  void beginFragment();
+
+  /// the recorded function, its source starting at offset `Source`,
+  /// offsets relative to its start; none when it touched more than .text
+  std::optional<std::string> endFragment(size_ty Source);
+
+  /// replay a recorded function at the current .text offset, as if its
+  /// source started at offset `Source`; false (and nothing added) when
+  /// `Fragment` is malformed
+  bool injectFragment(StringRef Fragment, size_ty Source);
+
 public:
   MCExpr* getTextExpr(std::string Symbol, MCExpr::ExprTy ty,
                       uint64_t Append = 0) {
@@ -169,7 +250,7 @@ public:
   }
 
   void addReloInst(MCInst* inst, std::string label) {
-    ReloInst.emplace(inst, std::move(label));
+    ReloInst.emplace_back(inst, std::move(label));
   }
 
   template <typename T> size_ty pushDataBuf(T&& Value) {
@@ -182,6 +263,22 @@ public:
     return this->DataBuffer.size();
   }
 
+  /// bytes of another file (.incbin), the object then depends on more
+  /// than its source
+  size_ty includeDataBuf(const void* Data, size_ty N) {
+    this->IncludesFiles = true;
+    this->DataBuffer.append(Data, N);
+    return this->DataBuffer.size();
+  }
+
+  bool includesFiles() const { return IncludesFiles; }
+
+  /// `Repeat` copies of the low `Size` bytes of `Value`
+  size_ty fillDataBuf(size_ty Repeat, size_ty Size, uint64_t Value) {
+    this->DataBuffer.repeat(&Value, Size, Repeat);
+    return this->DataBuffer.size();
+  }
+
   bool addDataVar(StringRef Varibale) {
     return this->DataVariables.insert(Varibale, this->DataBuffer.size());
   }
@@ -0,0 +1,31 @@
+#ifndef MC_FRAGMENT
+#define MC_FRAGMENT
+
+#include "utils/ADT/StringRef.hpp"
+#include <string>
+
+namespace mc {
+using StringRef = utils::ADT::StringRef;
+
+/// the .text of single functions recorded by earlier runs
+/// (MCContext::endFragment), keyed on the function's source and its .text
+/// offset modulo 4 (which decides the alignment padding inside)
+///
+/// a function is `.globl <name>` up to the next `.globl`/`.global` or
+/// section directive, an unchanged function is replayed instead of being
+/// lexed, parsed and encoded again
+class FragmentCache {
+public:
+  virtual ~FragmentCache() = default;
+
+  /// false on a miss
+  virtual bool lookup(StringRef Source, unsigned Align,
+                      std::string& Fragment) = 0;
+
+  virtual void insert(StringRef Source, unsigned Align,
+                      StringRef Fragment) = 0;
+};
+
+} // namespace mc
+
+#endif
@@ -7,10 +7,12 @@
 #include "utils/ADT/SmallVector.hpp"
 #include "utils/macro.hpp"
 #include "utils/source.hpp"
+#include <cstdint>
+#include <optional>
 
 namespace mc {
 
-using Location = utils::Location;
+using SourceLoc = utils::SourceLoc;
 
 class MCInst {
 public:
@@ -19,26 +21,26 @@ public:
 private:
   const MCOpCode* OpCode; // MCOpCode will all be static and constepxr
 
-  Location Loc;
   size_ty Offset; // offset from the begin of .text
   SmallVector<MCOperand, 6> Operands;
 
   bool relaxable = false;
+  /// in the padding after `relaxable`
+  SourceLoc Loc = 0;
 
-public:
-  explicit MCInst(const StringRef& _OpCode LIFETIME_BOUND)
-      : OpCode(parser::MnemonicFind(_OpCode.str().c_str())) {}
+  /// encoding reused from an earlier run, the operands are gone
+  std::optional<uint32_t> Encoded;
 
+public:
   explicit MCInst(const MCOpCode* _OpCode LIFETIME_BOUND) : OpCode(_OpCode) {}
 
-  explicit MCInst(const MCOpCode* _OpCode LIFETIME_BOUND, Location _Loc,
+  explicit MCInst(const MCOpCode* _OpCode LIFETIME_BOUND, SourceLoc _Loc,
                   size_ty _Offset)
-      : OpCode(_OpCode), Loc(_Loc), Offset(_Offset) {}
+      : OpCode(_OpCode), Offset(_Offset), Loc(_Loc) {}
 
-  explicit MCInst(const StringRef& _OpCode LIFETIME_BOUND, Location _Loc,
-                  size_ty _Offset)
-      : OpCode(parser::MnemonicFind(_OpCode.str().c_str())), Loc(_Loc),
-        Offset(_Offset) {}
+  explicit MCInst(const MCOpCode* _OpCode LIFETIME_BOUND, SourceLoc _Loc,
+                  size_ty _Offset, uint32_t _Encoded)
+      : OpCode(_OpCode), Offset(_Offset), Loc(_Loc), Encoded(_Encoded) {}
 
   [[nodiscard]] decltype(Operands)::size_ty getOpSize() const {
     return Operands.size();
@@ -52,7 +54,7 @@ public:
   }
 
   const MCOpCode* getOpCode() const { return OpCode; }
-  utils::Location getLoc() const { return Loc; }
+  SourceLoc getLoc() const { return Loc; }
 
   template <decltype(Operands)::size_ty Idx>
   const MCOperand& getOperand() const {
@@ -72,7 +74,7 @@ public:
 
   size_ty getOffset() const { return Offset; }
   void modifyOffset(size_ty newOffset) { Offset = newOffset; }
-  void modifyLoc(Location newLoc) { Loc = newLoc; }
+  void modifyLoc(SourceLoc newLoc) { Loc = newLoc; }
 
   using const_iter = decltype(Operands)::const_iter;
   using const_rev_iter = decltype(Operands)::const_rev_iter;
@@ -96,21 +98,21 @@ public:
 
   uint32_t getRiscvRType() const;
 
-  constexpr static MCInst makeNop(Location Loc, size_ty Offset) {
-    auto nop = MCInst(parser::MnemonicFind("addi"), Loc, Offset);
+  constexpr static MCInst makeNop(SourceLoc Loc, size_ty Offset) {
+    auto nop = MCInst(&ADDI, Loc, Offset);
     nop.addOperand(MCOperand::makeReg(*Registers.find("x0")));
     nop.addOperand(MCOperand::makeReg(*Registers.find("x0")));
     nop.addOperand(MCOperand::makeImm(0));
     return nop;
   }
 
-  constexpr static MCInst makeCNop(Location Loc, size_ty Offset) {
-    return MCInst(parser::MnemonicFind("c.nop"), Loc, Offset);
+  constexpr static MCInst makeCNop(SourceLoc Loc, size_ty Offset) {
+    return MCInst(&C_NOP, Loc, Offset);
   }
 
   using MCInsts = utils::ADT::SmallVector<MCInst, 4>;
 
-  static MCInsts makeLi(Location Loc, size_ty Offset, StringRef target,
+  static MCInsts makeLi(SourceLoc Loc, size_ty Offset, StringRef target,
                         int64_t imme);
 
   uint32_t makeEncoding() const;
@@ -268,7 +268,7 @@ public:
 #define ASM(name, pattern)                                                     \
   inline constexpr char _##name[] = #name;                                     \
   inline constexpr char _##name##_Pattern[] = #pattern;                        \
-  static constexpr MCOpCode name{_##name, _##name##_Pattern};
+  inline constexpr MCOpCode name{_##name, _##name##_Pattern};
 
 #define INSTRUCTION(name, pattern) ASM(name, pattern)
 #include "RISCV.def"
@@ -290,31 +290,24 @@ constexpr inline auto MnemonicMap = std::tuple{
 
 #undef INSTRUCTION
 
+/// `str` needn't be NUL-terminated, tokens view the source
 template <size_t N>
 constexpr bool MnemonicContainImpl(const std::array<char, N>& arr,
-                                   const char* c_str) {
-  for (size_t i = 0; i < N; ++i) {
-    if (arr[i] != c_str[i])
-      return false;
-    if (c_str[i] == '\0')
-      return arr[i] == '\0';
+                                   StringRef str) {
+  if (str.size() != N - 1) {
+    return false;
   }
-  return c_str[N] == '\0';
-}
-
-template <size_t I = 0, typename T>
-constexpr bool MnemonicContain(const T& value) {
-  if constexpr (I < std::tuple_size_v<decltype(MnemonicMap)>) {
-    if (MnemonicContainImpl(std::get<I>(MnemonicMap).first, value)) {
-      return true;
-    }
-    return MnemonicContain<I + 1>(value);
+  for (size_t i = 0; i + 1 < N; ++i) {
+    if (arr[i] != str.data()[i])
+      return false;
   }
-  return false;
+  return true;
 }
 
-template <size_t I = 0, typename T>
-constexpr const mc::MCOpCode* MnemonicFind(const T& value) {
+/// a linear search, for constant expressions (Pseudo patterns); tokens
+/// carry their opcode in Token::keyword
+template <size_t I = 0>
+constexpr const mc::MCOpCode* MnemonicFind(StringRef value) {
   if constexpr (I < std::tuple_size_v<decltype(MnemonicMap)>) {
     if (MnemonicContainImpl(std::get<I>(MnemonicMap).first, value)) {
       return std::get<I>(MnemonicMap).second;
@@ -66,7 +66,8 @@ public:
 
 private:
   struct InstPattern {
-    StringRef Op;
+    /// resolved along with the pattern, at compile time
+    const MCOpCode* Op = nullptr;
     std::array<OperandKind, 4> Operands{};
     uint32_t opNr;
     MCExpr::ExprTy reloTy = MCExpr::kInvalid;
@@ -84,7 +85,7 @@ private:
     for (uint32_t sonCnt = 0; sonCnt < rootNode->sonNr; ++sonCnt) {
       auto& son = rootNode->sons[sonCnt];
       auto& inst = InstPatterns[InstNr++];
-      inst.Op = son->content;
+      inst.Op = parser::MnemonicFind(son->content);
 
       /// @note enum the items that may appear in .def file
       for (auto operand : son->sons) {
@@ -261,7 +262,7 @@ public:
     auto instsBuild = [this](MCContext& ctx, auto... Args) {
       auto ArgsTuple = std::make_tuple(Args...);
 
-      SmallVector<StringRef, 4> Ops;
+      SmallVector<const MCOpCode*, 4> Ops;
       for (uint32_t instCnt = 0; instCnt < this->InstNr; ++instCnt) {
         Ops.emplace_back(this->InstPatterns[instCnt].Op);
       }
@@ -317,7 +318,7 @@ public:
 #define PSEUDO_DEF(name, pattern)                                              \
   inline constexpr char _##name##_pseudo[] = #name;                            \
   inline constexpr char _##name##_pseudo##_Pattern[] = #pattern;               \
-  static constexpr Pseudo name##_pseudo{_##name##_pseudo,                      \
+  inline constexpr Pseudo name##_pseudo{_##name##_pseudo,                      \
                                         _##name##_pseudo##_Pattern};
 
 #define PSEUDO(name, pattern) PSEUDO_DEF(name, pattern)
@@ -338,40 +339,6 @@ constexpr inline auto PseudoMap = std::tuple{
 
 #undef PSEUDO
 
-template <size_t N>
-constexpr bool PseudoContainImpl(const std::array<char, N>& arr,
-                                 const char* c_str) {
-  for (size_t i = 0; i < N; ++i) {
-    if (arr[i] != c_str[i])
-      return false;
-    if (c_str[i] == '\0')
-      return arr[i] == '\0';
-  }
-  return c_str[N] == '\0';
-}
-
-template <size_t I = 0, typename T>
-constexpr bool PseudoContain(const T& value) {
-  if constexpr (I < std::tuple_size_v<decltype(PseudoMap)>) {
-    if (PseudoContainImpl(std::get<I>(PseudoMap).first, value)) {
-      return true;
-    }
-    return PseudoContain<I + 1>(value);
-  }
-  return false;
-}
-
-template <size_t I = 0, typename T>
-constexpr const mc::Pseudo* PseudoFind(const T& value) {
-  if constexpr (I < std::tuple_size_v<decltype(PseudoMap)>) {
-    if (PseudoContainImpl(std::get<I>(PseudoMap).first, value)) {
-      return std::get<I>(PseudoMap).second;
-    }
-    return PseudoFind<I + 1>(value);
-  }
-  return nullptr;
-}
-
 } // namespace parser
 
 #endif
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef PARSER_KEYWORD
+#define PARSER_KEYWORD
+
+#include "utils/ADT/StringRef.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace mc {
+struct MCOpCode;
+struct Pseudo;
+} // namespace mc
+
+namespace parser {
+
+enum class Directive : std::uint8_t {
+  kText,
+  kData,
+  kBss,
+  kGlobl, // .globl, .global
+  kHalf,
+  kWord,
+  kDword,
+  kAlign,
+  kBalign,
+  kZero,
+  kSpace,
+  kFloat,
+  kDouble,
+  kFill,
+  kIncbin,
+};
+
+inline constexpr std::size_t DirectiveNr =
+    static_cast<std::size_t>(Directive::kIncbin) + 1;
+
+/// a word the assembler gives a meaning to: mnemonics, pseudos, registers
+/// (ABI names included), rounding modes, directives and `%` modifiers
+struct Keyword {
+  /// flags, a mnemonic may be a pseudo too (lw, j, call ...)
+  enum Kind : std::uint8_t {
+    kMnemonic = 1 << 0,
+    kPseudo = 1 << 1,
+    kLi = 1 << 2,
+    kRegister = 1 << 3,
+    kMode = 1 << 4,
+    kDirective = 1 << 5,
+    kModifier = 1 << 6,
+  };
+
+  utils::ADT::StringRef Name;
+  std::uint8_t Kinds = 0;
+  /// register number, rounding mode bits, Directive or MCExpr::ExprTy
+  std::uint8_t Value = 0;
+  const mc::MCOpCode* OpCode = nullptr;
+  const mc::Pseudo* Pseudo = nullptr;
+
+  constexpr bool is(Kind K) const { return Kinds & K; }
+  constexpr bool is(Directive D) const {
+    return is(kDirective) && Value == static_cast<std::uint8_t>(D);
+  }
+
+  constexpr bool isInstruction() const {
+    return Kinds & (kMnemonic | kPseudo | kLi);
+  }
+
+  /// both a mnemonic and a pseudo, the operands tell which one is meant
+  constexpr bool isAmbiguous() const {
+    return is(kMnemonic) && is(kPseudo);
+  }
+};
+
+/// one probe of a perfect hash built at compile time, `Word` spelled in
+/// lowercase (directives with their '.', modifiers with their '%')
+const Keyword* findKeyword(utils::ADT::StringRef Word);
+
+/// position of `K` in the table findKeyword() returns from, and back
+std::uint16_t keywordIndex(const Keyword* K);
+const Keyword* keywordAt(std::uint16_t Index);
+
+} // namespace parser
+
+#endif
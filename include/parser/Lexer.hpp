@@ -3,14 +3,22 @@
 
 #include "mc/MCInst.hpp"
 #include "mc/MCOpCode.hpp"
+#include "parser/Keyword.hpp"
 #include "utils/ADT/StringRef.hpp"
+#include "utils/source.hpp"
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
 #include <string>
+#include <vector>
 
 namespace parser {
 using StringRef = utils::ADT::StringRef;
+using SourceLoc = utils::SourceLoc;
 
-enum class TokenType {
+enum class TokenType : std::uint8_t {
   UNKNOWN,
   END_OF_FILE,
   NEWLINE,
@@ -41,77 +49,143 @@ enum class TokenType {
 std::string to_string(TokenType type);
 
 struct Token {
-  TokenType type;
-  std::string lexeme;
-  mc::Location loc;
-
-  Token() { this->type = TokenType::UNKNOWN; }
-
-  Token(TokenType _type, std::string _lex, mc::Location _loc)
-      : type(_type), lexeme(std::move(_lex)), loc(_loc) {}
-
-  Token(const Token& token) {
-    this->type = token.type;
-    this->lexeme = token.lexeme;
-    this->loc = token.loc;
-  }
-
-  Token& operator=(const Token& token) {
-    this->type = token.type;
-    this->lexeme = token.lexeme;
-    this->loc = token.loc;
-    return *this;
-  }
+  TokenType type = TokenType::UNKNOWN;
+  /// numbers: the literal is out of range (or a bare "0x")
+  bool invalid = false;
+  /// FLOAT: the literal rounded to single precision, NaN if out of range
+  float single = 0;
+  /// views the source, or the lexer's lowercase spelling of a keyword
+  /// written in another case; valid until the lexer moves past the line
+  StringRef lexeme;
+  /// where the token starts, wraps past 4 GiB (see Lexer::tokenOffset())
+  SourceLoc loc = 0;
+  /// instructions, registers, modes, known directives and modifiers
+  const Keyword* keyword = nullptr;
+  /// decoded once by the lexer: INTEGER its value, HEX_INTEGER its bits,
+  /// FLOAT the bits of its double
+  std::uint64_t value = 0;
+
+  Token() = default;
+
+  Token(TokenType _type, StringRef _lex, SourceLoc _loc)
+      : type(_type), lexeme(_lex), loc(_loc) {}
 
   void print() const;
 };
 
+class TokenStream;
+
 class Lexer {
 public:
   Lexer(StringRef source);
 
+  /// incremental: `source` is pulled a chunk at a time, only the unread part
+  /// of the current line stays buffered
+  Lexer(utils::SourceStream& source);
+
+  /// replay a source lexed up front, no byte is scanned again
+  Lexer(const TokenStream& tokens);
+
   const Token& nextToken();
 
-  template <std::size_t N> SmallVector<Token, N> peekNextTokens() {
-    SmallVector<Token, N> tokens{};
+  /// the core tokens are scanned with, picked at build time
+  /// (-DENABLE_TABLE_LEXER=ON): "table" or "branchy"
+  static const char* core();
 
-    auto s_m_cursor = m_cursor;
-    auto s_m_line = m_line;
-    auto s_m_col = m_col;
+  /// the whole source is in memory, functions can be looked at (and
+  /// skipped) as a whole
+  bool isRandomAccess() const { return !m_stream; }
 
-    for (auto i = 0ull; i < N; ++i) {
-      tokens.emplace_back(this->nextToken());
-    }
+  /// offset of the last token returned
+  std::size_t tokenOffset() const { return m_dropped + m_start; }
 
-    m_cursor = s_m_cursor;
-    m_line = s_m_line;
-    m_col = s_m_col;
+  /// line and column of a tokenOffset(), counted on first use
+  utils::Location locate(std::size_t Offset) const;
 
-    return tokens;
+  StringRef slice(std::size_t Begin, std::size_t End) const {
+    return m_source.slice(Begin, End);
   }
 
+  /// end of the function whose `.globl` starts at `From`: the next line
+  /// opening with `.globl`, `.global` or a section directive, or the end
+  std::size_t findFunctionEnd(std::size_t From) const;
+
+  /// continue lexing at `Offset`, found by findFunctionEnd(), the tokens in
+  /// between are never seen
+  void skipTo(std::size_t Offset);
+
 private:
   StringRef m_source;
 
-  /// location infomation
+  /// streaming input, m_source then views m_window
+  utils::SourceStream* m_stream = nullptr;
+  std::string m_window;
+  /// bytes already discarded in front of m_window
+  std::size_t m_dropped = 0;
+  /// one past the last '\n' in m_window: lines before it are complete
+  std::size_t m_complete = 0;
+  /// windows replaced by fill(), tokens handed out may still view them
+  std::vector<std::string> m_retired;
+
+  /// pre-tokenized input, m_source then is its source
+  const TokenStream* m_tokens = nullptr;
+  /// the next token of m_tokens
+  std::size_t m_token = 0;
+
+  /// the next token of m_tokens, rebuilt
+  const Token& replay();
+
+  /// make sure the line under the cursor is buffered completely
+  void fill();
+
   std::size_t m_cursor = 0;
-  std::size_t m_line = 1;
-  std::size_t m_col = 1;
+  /// start of the last token scanned
+  std::size_t m_start = 0;
+
+  /// built by the first locate()
+  mutable std::optional<utils::LineIndex> m_lines;
+
+  /// of the last token scanned, stream offsets wrap past 4 GiB
+  SourceLoc sourceLoc() const {
+    return static_cast<SourceLoc>(m_dropped + m_start);
+  }
 
   bool isAtEnd() const;
   char advance();
   char peek() const;
   char peekNext() const;
 
+  const char* cursor() const { return m_source.data() + m_cursor; }
+  const char* end() const { return m_source.data() + m_source.size(); }
+  /// move the cursor to `Stop`, never past the end of the current line
+  void advanceTo(const char* Stop) { m_cursor = Stop - m_source.data(); }
+
+  /// the last token scanned
   Token lastToken{};
 
+  /// keywords written in another case than lower, spelled in lowercase once
+  std::deque<std::string> m_lowered;
+
+  /// the copy of the lowercase keyword `key` in m_lowered
+  StringRef internLowered(StringRef key);
+
   void skipWhitespaceAndComments();
   const Token& makeToken(TokenType type);
   const Token& makeToken(TokenType type, StringRef lexeme);
   const Token& errorToken(const char* message) const;
 
+  /// the token at the cursor
+  const Token& scan();
+  /// scan() driven by a constexpr table of state x character class, a
+  /// lookup per byte instead of a chain of tests (LexerTable.cpp)
+  const Token& scanTable();
   const Token& scanIdentifier();
+  /// classify the word starting at `Start` and ending at the cursor, which
+  /// is not a label: keyword, directive or plain identifier
+  const Token& makeWord(std::size_t Start);
   const Token& scanNumber();
+  /// fill in the value of the numeric lastToken
+  void decodeNumber();
   const Token& scanString();
 };
 } // namespace parser
@@ -3,12 +3,17 @@
 
 #include "Lexer.hpp"
 #include "mc/MCContext.hpp"
+#include "mc/MCFragment.hpp"
 #include "mc/MCInst.hpp"
 #include "mc/MCOpCode.hpp"
 #include "mc/Pseudo.hpp"
 #include "utils/ADT/StringMap.hpp"
 #include "utils/macro.hpp"
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <optional>
+#include <string>
 
 template <typename T> using StringSwitch = utils::ADT::StringSwitch<T>;
 template <typename T, std::size_t N>
@@ -18,34 +23,85 @@ using mc::MCInst;
 
 namespace parser {
 
-template <typename V> using StringMap = utils::ADT::StringMap<V>;
-
 class Parser {
 private:
   mc::MCContext& ctx;
   Lexer& lexer;
 
-  /// speed up mnemnoic class find
-  StringMap<const mc::MCOpCode*> OpCacheTab;
+  /// functions of earlier runs, replayed when their source is unchanged
+  mc::FragmentCache* Fragments = nullptr;
+
+  /// where relative .incbin paths start, empty: the working directory
+  StringRef IncludeDir;
 
 public:
-  Parser(mc::MCContext& _ctx LIFETIME_BOUND, Lexer& _lexer LIFETIME_BOUND)
-      : ctx(_ctx), lexer(_lexer) {}
+  Parser(mc::MCContext& _ctx LIFETIME_BOUND, Lexer& _lexer LIFETIME_BOUND,
+         mc::FragmentCache* _Fragments = nullptr,
+         StringRef _IncludeDir = "")
+      : ctx(_ctx), lexer(_lexer), Fragments(_Fragments),
+        IncludeDir(_IncludeDir) {}
 
   void parse();
 
+  /// parse a single function on its own, `lexer` holding just its source
+  /// (`.globl` up to Lexer::findFunctionEnd()) as if it started at a
+  /// 4-aligned .text offset; what parse() would record for it there, none
+  /// when it doesn't stand alone
+  std::optional<std::string> parseFunction();
+
   ~Parser() = default;
 
 private:
   Token token;
   MCInst* curInst = nullptr;
-  SmallVector<std::string, 4> DirectiveStack{};
+
+  enum class Section : std::uint8_t { kNone, kText, kData, kBss };
+  static constexpr std::size_t SectionNr = 4;
+
+  /// where labels and data go
+  Section curSection = Section::kNone;
+  /// the directive waiting for its operand (.globl or a data directive)
+  std::optional<Directive> pendingDirective;
+  /// the data directive of this statement, a ',' hands it one more operand
+  std::optional<Directive> dataDirective;
+  /// operands of a data directive that only acts once its statement ends
+  /// (.space, .fill, .incbin, and .zero/.space in .bss)
+  SmallVector<std::uint64_t, 3> dataArgs;
+  std::string incbinPath;
+
+  /// what a literal of a directive does in a section, nullptr: the
+  /// directive takes no literal there
+  using DataHandler = void (Parser::*)();
+  using DataHandlerTable =
+      std::array<std::array<DataHandler, DirectiveNr>, SectionNr>;
+  static const DataHandlerTable DataHandlers;
+
+  /// in .text and nothing pending, a function may start or end here
+  bool atTextStatement() const {
+    return !curInst && curSection == Section::kText && !pendingDirective;
+  }
 
   MCContext::size_ty curTextOffset = 0;
   MCContext::size_ty curDataOffset = 0;
   MCContext::size_ty curBssOffset = 0;
 
+  /// the function being recorded into a fragment
+  struct Function {
+    std::size_t Begin, End;
+    unsigned Align;
+  };
+  std::optional<Function> Recorded;
+
+  /// at a `.globl` in .text: replay the function it starts (true, the
+  /// token is already past it) or start recording it
+  bool beginFunction();
+  /// hand the recorded function to the cache
+  void finishFunction();
+
   void advance();
+  /// line and column of the current token (its byte offset in a stream),
+  /// for diagnostics; from Lexer::tokenOffset(), token.loc wraps at 4 GiB
+  std::string where() const;
   uint8_t RegHelper(const StringRef& reg);
   void JrBrHelper(const StringRef& label);
 
@@ -72,42 +128,65 @@ private:
   void ParseLabelDef();
   void ParseString();
 
-  /// this method assume mnemoic is valid
-  const mc::MCOpCode* findOpCode(StringRef mnemonic);
-
-  /// whether is a instruction or pseudo
-  /// {l|s}{b|w|d} + jal jalr
-  bool isPseudo() {
-    utils_assert(token.type == TokenType::INSTRUCTION,
-                 "not a asm inst or pseudo");
-
-    auto op = token.lexeme.c_str();
-
-    if (MnemonicContain(op) && PseudoContain(op)) {
-
-      return StringSwitch<bool>(op)
-          .BeginWith("j",
-                     [&](auto&& _) {
-                       auto peekTokens = lexer.peekNextTokens<2>();
-                       if (peekTokens.back().type == TokenType::NEWLINE) {
-                         return true;
-                       } else {
-                         return false;
-                       }
-                     })
-          .Default([&](auto&& _) {
-            auto peekTokens = lexer.peekNextTokens<4>();
-            if (peekTokens.back().type == TokenType::NEWLINE) {
-              return true;
-            } else {
-              return false;
-            }
-          });
-
-    } else {
-      return PseudoContain(op);
-    }
-  }
+  /// a literal outside an instruction, the operand of pendingDirective
+  void ParseData();
+  /// the INTEGER or HEX_INTEGER operand of a data directive
+  std::uint64_t DataInteger() const;
+  /// at the end of a data statement, emit what its operands describe
+  void endData();
+
+  void DataHalf();
+  void DataWord();
+  void DataDword();
+  void DataAlign();
+  void DataBalign();
+  void DataFloat();
+  void DataDouble();
+  void DataSpace();
+  void DataFill();
+  void DataIncbin();
+  void BssZero();
+  void BssAlign();
+  void BssBalign();
+
+  /// an operand of an instruction or pseudo, parsed before the statement
+  /// is known to be one or the other (lw, sd, jal ...)
+  struct Operand {
+    enum Shape : std::uint8_t {
+      kReg,    // rd/rs, or the base of imm(reg)
+      kImm,    // an integer or a rounding mode
+      kSymbol, // a bare symbol
+      kExpr,   // %modifier(symbol +- integer)
+    };
+
+    Shape shape;
+    /// kReg: the (reg) of a memory operand
+    bool InParens = false;
+    std::uint8_t Reg = 0;
+    std::int64_t Imm = 0;
+    mc::MCExpr::ExprTy Modifier = mc::MCExpr::kInvalid;
+    std::uint64_t Append = 0;
+    std::string Symbol;
+  };
+  using Operands = SmallVector<Operand, 4>;
+
+  /// the operands up to the end of the statement, which is left as token
+  Operands collectOperands();
+  /// from a MODIFIERS token to its ')', which is left as token
+  Operand parseModifier();
+  /// onto curInst, the way the operand parsers add it
+  void addOperand(const Operand& Op);
+
+  /// the inst `OpCode` at curTextOffset, padded to its alignment
+  void beginInstruction(const mc::MCOpCode* OpCode, SourceLoc Loc);
+  /// `Ops` expanded by `P`
+  void emitPseudo(const mc::Pseudo& P, const Operands& Ops);
+
+  /// a mnemonic that is a pseudo too: {l|s}{b|h|w|d}, fl/fs d, jal, jalr
+  /// the pseudo takes a bare symbol where a load/store takes imm(reg), and
+  /// a lone operand where jal/jalr take a register first
+  void ParseAmbiguous();
+  static bool isPseudoForm(const Keyword& K, const Operands& Ops);
 };
 
 } // namespace parser
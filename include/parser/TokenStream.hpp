@@ -0,0 +1,94 @@
+#ifndef PARSER_TOKENSTREAM
+#define PARSER_TOKENSTREAM
+
+#include "parser/Keyword.hpp"
+#include "parser/Lexer.hpp"
+#include "utils/ADT/StringRef.hpp"
+#include "utils/ThreadPool.hpp"
+#include "utils/macro.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace parser {
+
+/// a whole source lexed up front into parallel arrays, 8 bytes a token:
+/// kind, offset, length and keyword; numeric literals keep their decoded
+/// payload on the side
+/// lexemes are never copied, a token is rebuilt from the source on demand;
+/// replayed through Lexer(const TokenStream&)
+class TokenStream {
+public:
+  /// lex all of `Source`, the last token is the END_OF_FILE
+  /// with a `Pool`, a large source is cut at line ends and the pieces are
+  /// lexed concurrently, the stream is the same
+  explicit TokenStream(StringRef _Source LIFETIME_BOUND,
+                       utils::ThreadPool* Pool = nullptr);
+
+  /// offsets are 32-bit, a larger source is lexed as it is parsed instead
+  static bool fits(StringRef Source) {
+    return Source.size() < std::numeric_limits<std::uint32_t>::max();
+  }
+
+  std::size_t size() const { return Kinds.size(); }
+  StringRef source() const { return Source; }
+
+  TokenType kind(std::size_t i) const { return Kinds[i]; }
+  /// where the i-th token starts in the source
+  std::size_t offset(std::size_t i) const { return Offsets[i]; }
+  /// instructions, registers and modes are spelled in lowercase
+  StringRef lexeme(std::size_t i) const;
+  const Keyword* keyword(std::size_t i) const {
+    return Keywords[i] ? keywordAt(Keywords[i] - 1) : nullptr;
+  }
+
+  /// what the lexer decoded an INTEGER, HEX_INTEGER or FLOAT token to
+  struct Number {
+    std::uint64_t Value;
+    float Single;
+    bool Invalid;
+  };
+  const Number& number(std::size_t i) const;
+
+  /// the first token starting at or after `Offset`
+  std::size_t find(std::size_t Offset) const;
+
+  /// bytes the arrays hold, the source aside
+  std::size_t bytes() const;
+
+private:
+  StringRef Source;
+
+  TokenStream() = default;
+
+  void push(TokenType Kind, std::size_t Offset, std::size_t Length,
+            const Keyword* K);
+  /// the tokens of [Begin, End), which starts a line, END_OF_FILE aside
+  void lex(std::size_t Begin, std::size_t End);
+  /// the pieces between `Bounds` on `Pool`, stitched back together
+  void lexPieces(const std::vector<std::size_t>& Bounds,
+                 utils::ThreadPool& Pool);
+  /// tokens of a piece lexed on its own
+  void append(const TokenStream& Piece);
+
+  std::vector<TokenType> Kinds;
+  std::vector<std::uint32_t> Offsets;
+  /// lexeme size, LongLength: looked up in Long
+  std::vector<std::uint8_t> Lengths;
+  /// keywordIndex() + 1, 0 for none
+  std::vector<std::uint16_t> Keywords;
+
+  /// token index and size of the lexemes too long for Lengths (strings)
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> Long;
+
+  /// token index and payload of the numeric literals, replay does no
+  /// decoding
+  std::vector<std::pair<std::uint32_t, Number>> Numbers;
+  static constexpr std::uint8_t LongLength = 0xff;
+};
+
+} // namespace parser
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef RVASM_ASSEMBLER
+#define RVASM_ASSEMBLER
+
+#include "utils/ADT/StringRef.hpp"
+#include "utils/ThreadPool.hpp"
+#include "utils/output.hpp"
+#include <cstddef>
+#include <optional>
+#include <string>
+
+/// in-process entry point of librvasm: assembly text in, ELF64 relocatable
+/// object bytes out, no files, no fork/exec
+
+namespace rvasm {
+using StringRef = utils::ADT::StringRef;
+
+struct Options {
+  /// fill the sections of large objects on this pool, none: the caller
+  utils::ThreadPool* Pool = nullptr;
+  /// lex the whole source into a parser::TokenStream before parsing it,
+  /// a large one on `Pool` (unless TokenStream::fits() says it can't)
+  bool PreTokenize = false;
+};
+
+/// the assembled object, or why there is none
+class ObjectBuffer {
+  std::optional<utils::OutputBuffer> Image;
+  std::string Error;
+
+public:
+  explicit ObjectBuffer(utils::OutputBuffer&& _Image)
+      : Image(std::move(_Image)) {}
+  explicit ObjectBuffer(std::string _Error) : Error(std::move(_Error)) {}
+
+  bool ok() const { return Image.has_value(); }
+  explicit operator bool() const { return ok(); }
+
+  /// empty on failure
+  StringRef bytes() const {
+    return ok() ? StringRef(Image->data(), Image->size()) : StringRef();
+  }
+
+  const char* data() const { return bytes().data(); }
+  std::size_t size() const { return bytes().size(); }
+
+  /// empty on success
+  const std::string& error() const { return Error; }
+};
+
+/// reentrant: every call owns its Lexer, Parser and MCContext, any number of
+/// threads may assemble at once
+/// malformed input is returned as an error, the process is never aborted
+ObjectBuffer assemble(StringRef Source, const Options& Opts = {});
+
+} // namespace rvasm
+
+#endif
@@ -3,7 +3,10 @@
 
 #include "SmallVector.hpp"
 #include "StringRef.hpp"
+#include <algorithm>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace utils {
 namespace ADT {
@@ -19,38 +22,41 @@ struct ByteStream {
 
   size_ty size() const { return buffer.size(); }
 
-  void balignTo(size_ty balign) {
-    auto paddingSize = (balign - (buffer.size() % balign)) % balign;
-
-    for (auto i = 0ull; i < paddingSize; ++i) {
-      buffer.push_back('\x00');
+  /// room for `N` more bytes, at least doubling the capacity so a run of
+  /// bulk appends stays linear
+  void grow(size_ty N) {
+    if (buffer.size() + N > buffer.capacity()) {
+      buffer.reserve(std::max(buffer.size() + N, buffer.capacity() * 2));
     }
   }
 
-  template <IsPOD T> ByteStream& operator<<(T&& Value) {
+  void append(const void* Data, size_ty N) {
+    auto bytes = static_cast<const uint8_t*>(Data);
+    grow(N);
+    buffer.insert(buffer.end(), bytes, bytes + N);
+  }
 
-    this->balignTo(sizeof(T));
+  /// `Count` copies of the `N` bytes at `Pattern`
+  void repeat(const void* Pattern, size_ty N, size_ty Count);
 
-    for (unsigned long i = 0; i < sizeof(T); ++i) {
-      buffer.push_back(((uint8_t*)(&Value))[i]);
-    }
+  void balignTo(size_ty balign) {
+    auto paddingSize = (balign - (buffer.size() % balign)) % balign;
+    buffer.resize(buffer.size() + paddingSize);
+  }
 
+  template <IsPOD T> ByteStream& operator<<(T&& Value) {
+    this->balignTo(sizeof(T));
+    append(&Value, sizeof(T));
     return *this;
   }
 
   template <size_ty Num> ByteStream& operator<<(const char (&Value)[Num]) {
-    for (size_ty i = 0; i < Num; ++i) {
-      buffer.push_back(Value[i]);
-    }
-
+    append(Value, Num);
     return *this;
   }
 
   ByteStream& operator<<(const std::string& Value) {
-    for (size_ty i = 0; i < Value.size(); ++i) {
-      buffer.push_back(Value[i]);
-    }
-
+    append(Value.data(), Value.size());
     return *this;
   }
 
@@ -58,6 +58,9 @@ public:
   constexpr StringRef(const StringRef& StrRef)
       : Data(StrRef.Data), Length(StrRef.Length) {}
 
+  /// const sources (members of a const object), the template takes the rest
+  constexpr StringRef& operator=(const StringRef& StrRef) = default;
+
   template <typename T> constexpr StringRef& operator=(T&& StrRef) {
     static_assert(
         std::is_same_v<std::remove_reference_t<T>, StringRef> ||
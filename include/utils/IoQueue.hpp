@@ -0,0 +1,97 @@
+#ifndef UTILS_IOQUEUE
+#define UTILS_IOQUEUE
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+/// whole-file reads and writes done off the calling threads
+/// one I/O thread opens the files and keeps at most `Depth` requests in
+/// flight on an io_uring; kernels (or sandboxes) without io_uring get the
+/// same thread doing plain pread/pwrite instead
+class IoQueue {
+public:
+  using size_ty = std::size_t;
+
+  struct Stats {
+    const char* Backend = "none";
+    std::uint64_t Reads = 0;
+    std::uint64_t Writes = 0;
+    std::uint64_t Bytes = 0;
+    /// time callers spent blocked in wait() and drain()
+    std::uint64_t WaitNs = 0;
+  };
+
+  struct Request;
+  using Handle = std::shared_ptr<Request>;
+
+private:
+  class Ring;
+
+  unsigned Depth;
+  std::unique_ptr<Ring> Uring;
+
+  mutable std::mutex Lock;
+  /// a request finished, or one was queued (pread/pwrite backend)
+  std::condition_variable Changed;
+
+  std::deque<Handle> Queued;
+  size_ty PendingWrites = 0;
+  bool Stopping = false;
+
+  /// first failed write and its path, reported by drain()
+  std::string WriteFailure;
+
+  Stats Counters;
+
+  /// wakes the io_uring backend up for new requests
+  int Wakeup = -1;
+
+  std::thread Worker;
+
+  void submit(Handle Req);
+  void finish(Request& Req, const char* Failure);
+
+  /// open the file and size the transfer, false once `Req` finished
+  bool start(Request& Req);
+
+  void runUring();
+  void runBlocking();
+
+public:
+  /// `Depth` requests in flight at most (the io_uring size)
+  explicit IoQueue(unsigned _Depth = 16);
+  IoQueue(const IoQueue&) = delete;
+  IoQueue& operator=(const IoQueue&) = delete;
+
+  /// finishes the queued requests, failures go unreported
+  ~IoQueue();
+
+  /// start reading all of `Path`
+  Handle read(std::string Path);
+
+  /// bytes of a read(), blocks until they arrived
+  std::string wait(const Handle& Read);
+
+  /// replace `Path` by `Bytes` in the background (a staged file renamed
+  /// over it once complete, like utils::OutputBuffer::create), blocks while `Depth` writes are pending
+  /// so finished bytes never pile up in memory
+  void write(std::string Path, std::vector<char> Bytes);
+
+  /// block until every write finished, fails on the first failed one
+  void drain();
+
+  Stats stats() const;
+};
+
+} // namespace utils
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef UTILS_THREADPOOL
+#define UTILS_THREADPOOL
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+/// work-stealing pool: every worker owns a deque, runs its own tasks LIFO and
+/// steals FIFO from the other workers once it runs dry
+class ThreadPool {
+public:
+  using size_ty = std::size_t;
+  using Task = std::function<void()>;
+
+  /// a set of tasks that can be waited on independently of the pool
+  class TaskGroup {
+    ThreadPool& Pool;
+
+    std::atomic<size_ty> Pending = 0;
+    std::mutex Lock;
+    std::condition_variable Done;
+
+    /// first exception thrown by a task, rethrown by wait()
+    std::exception_ptr Failure;
+
+    void join();
+
+  public:
+    explicit TaskGroup(ThreadPool& _Pool) : Pool(_Pool) {}
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    ~TaskGroup() { join(); }
+
+    /// tasks run in the recoverable mode (see utils/logger.hpp) of the
+    /// thread that submits them
+    void async(Task T);
+
+    /// block until every task of the group finished
+    /// the caller keeps running queued tasks meanwhile, so a pool task may
+    /// wait on a nested group without starving the pool
+    /// rethrows the first exception a task threw
+    void wait();
+  };
+
+private:
+  struct WorkQueue {
+    std::mutex Lock;
+    std::deque<Task> Tasks;
+  };
+
+  std::vector<std::unique_ptr<WorkQueue>> Queues;
+  std::vector<std::thread> Workers;
+
+  std::atomic<size_ty> Queued = 0;
+  std::atomic<size_ty> NextQueue = 0;
+
+  std::mutex SleepLock;
+  std::condition_variable WakeUp;
+  bool Stopping = false;
+
+  void push(Task T);
+
+  /// pop a task of `Self` or steal one from the others, false if all empty
+  bool runOne(size_ty Self);
+
+  void workerLoop(size_ty Self);
+
+  /// index of the queue owned by the calling thread, or none
+  size_ty selfQueue() const;
+
+public:
+  /// 0 means one worker per hardware thread
+  explicit ThreadPool(unsigned ThreadNr = 0);
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool();
+
+  size_ty size() const { return Workers.size(); }
+};
+
+} // namespace utils
+
+#endif
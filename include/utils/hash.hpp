@@ -0,0 +1,15 @@
+#ifndef UTILS_HASH
+#define UTILS_HASH
+
+#include "utils/ADT/StringRef.hpp"
+#include <cstdint>
+
+namespace utils {
+
+/// XXH64 (xxHash, 64-bit variant): several GB/s, well distributed, stable
+/// across runs and hosts, so fit to key on-disk content
+std::uint64_t xxhash64(ADT::StringRef Data, std::uint64_t Seed = 0);
+
+} // namespace utils
+
+#endif
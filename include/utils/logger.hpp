@@ -2,10 +2,13 @@
 #define UTILS_LOGGER_HPP
 
 #include <chrono>
+#include <cstdlib>
 #include <format>
 #include <iostream>
 #include <mutex>
 #include <source_location>
+#include <stdexcept>
+#include <string>
 #include <string_view>
 #include <utility>
 
@@ -36,6 +39,31 @@ inline std::string colorize(std::string_view text, std::string_view color) {
 namespace utils {
 namespace logger {
 
+/// what unreachable/todo/failed asserts throw inside a recoverable_scope
+class fatal_error : public std::runtime_error {
+public:
+    fatal_error(std::string_view message, const std::source_location& location)
+        : std::runtime_error(std::string(message)), file(location.file_name()),
+          line(location.line()) {}
+
+    const char* file;
+    unsigned line;
+};
+
+inline thread_local unsigned recoverable_depth = 0;
+
+/// while alive, errors on this thread throw fatal_error instead of tearing
+/// the whole process down (library / daemon use)
+struct recoverable_scope {
+    recoverable_scope() { ++recoverable_depth; }
+    ~recoverable_scope() { --recoverable_depth; }
+
+    recoverable_scope(const recoverable_scope&) = delete;
+    recoverable_scope& operator=(const recoverable_scope&) = delete;
+};
+
+inline bool is_recoverable() { return recoverable_depth != 0; }
+
 template <typename... Args>
 void info(std::string_view format_str, Args&&... args) {
     std::lock_guard<std::mutex> lock(log_mutex);
@@ -51,9 +79,29 @@ void info(std::string_view format_str, Args&&... args) {
     }
 }
 
+/// something went wrong but the process carries on
+template <typename... Args>
+void warn(std::string_view format_str, Args&&... args) {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    try {
+        std::cerr << std::format(
+            "[{}] [{}] {}\n", get_formatted_timestamp(),
+            colorize("WARN", COLOR_YELLOW),
+            std::vformat(format_str, std::make_format_args(args...)));
+    } catch (const std::format_error& e) {
+        std::cerr << std::format("[{}] [{}] Formatting error: {}\n",
+                                 get_formatted_timestamp(),
+                                 colorize("LOGGER_ERROR", COLOR_RED), e.what());
+    }
+}
+
 [[noreturn]] inline void unreachable(
     std::string_view message = "Unreachable code executed",
     const std::source_location& location = std::source_location::current()) {
+    if (is_recoverable()) {
+        throw fatal_error(message, location);
+    }
+
     std::lock_guard<std::mutex> lock(log_mutex);
     std::cerr << std::format(
         "[{}] [{}] {}\n"
@@ -67,6 +115,10 @@ void info(std::string_view format_str, Args&&... args) {
 [[noreturn]] inline void
 todo(std::string_view message = "NoImplmented code executed",
      const std::source_location& location = std::source_location::current()) {
+    if (is_recoverable()) {
+        throw fatal_error(message, location);
+    }
+
     std::lock_guard<std::mutex> lock(log_mutex);
     std::cerr << std::format(
         "[{}] [{}] {}\n"
@@ -77,12 +129,33 @@ todo(std::string_view message = "NoImplmented code executed",
     std::unreachable();
 }
 
+/// bad user input (a missing file, a malformed argument...): reported
+/// without the assembler's own whereabouts, the process fails cleanly
+[[noreturn]] inline void
+error(std::string_view message,
+      const std::source_location& location = std::source_location::current()) {
+    if (is_recoverable()) {
+        throw fatal_error(message, location);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(log_mutex);
+        std::cerr << std::format("[{}] [{}] {}\n", get_formatted_timestamp(),
+                                 colorize("ERROR", COLOR_RED), message);
+    }
+    std::exit(EXIT_FAILURE);
+}
+
 /// assert inner
 inline void assert_handler(bool condition, std::string_view expression,
                            std::string_view message,
                            const std::source_location& location) {
 
     if (!condition) {
+        if (is_recoverable()) {
+            throw fatal_error(message, location);
+        }
+
         std::lock_guard<std::mutex> lock(log_mutex);
         std::cerr << std::format("[{}] [{}] {}\n"
                                  "  -> Expression: {}\n"
@@ -100,9 +173,13 @@ inline void assert_handler(bool condition, std::string_view expression,
 } // namespace logger
 
 using logger::assert_handler;
+using logger::error;
+using logger::fatal_error;
+using logger::recoverable_scope;
 using logger::info;
 using logger::todo;
 using logger::unreachable;
+using logger::warn;
 
 } // namespace utils
 
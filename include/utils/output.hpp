@@ -0,0 +1,84 @@
+#ifndef UTILS_OUTPUT
+#define UTILS_OUTPUT
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace utils {
+
+/// a fresh name next to `Path` (`<Path>.tmp.<pid>.<n>`) for a file that is
+/// renamed over it once complete
+std::string stagedPath(const char* Path);
+
+/// writable image of an output file whose size is known up front
+/// a regular file is staged next to its destination, truncated to size and
+/// mmapped, the image is filled in place; pipes/ttys fall back to a heap
+/// buffer written out on commit
+/// only commit() publishes, an image dropped without it leaves the
+/// destination as it was
+class OutputBuffer {
+public:
+  using size_ty = std::size_t;
+
+private:
+  char* Data = nullptr;
+  size_ty Size = 0;
+
+  /// non-zero when Data is a shared mapping of the file
+  size_ty MappedSize = 0;
+
+  /// write() fallback storage and its destination, -1 once committed
+  std::vector<char> Owned;
+  int Fd = -1;
+  bool OwnsFd = false;
+
+  /// commit() renames Staged to Path, both empty when written in place
+  std::string Path;
+  std::string Staged;
+
+  OutputBuffer() = default;
+
+  /// drop the image: unmap, close, remove the staged file
+  void discard();
+
+public:
+  OutputBuffer(const OutputBuffer&) = delete;
+  OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+  OutputBuffer(OutputBuffer&& Other);
+  OutputBuffer& operator=(OutputBuffer&& Other);
+
+  /// discards unless commit() was called already, never throws
+  ~OutputBuffer();
+
+  /// `Size` zeroed bytes that replace `Path` on commit
+  static OutputBuffer create(const char* Path, size_ty Size);
+
+  /// `Size` zeroed bytes for an already opened descriptor, caller keeps
+  /// ownership of fd
+  static OutputBuffer fromFd(int Fd, size_ty Size);
+
+  /// `Size` zeroed bytes that never leave memory, commit() drops them
+  static OutputBuffer inMemory(size_ty Size) { return fromFd(-1, Size); }
+
+  char* data() { return Data; }
+
+  const char* data() const { return Data; }
+
+  size_ty size() const { return Size; }
+
+  bool isMapped() const { return MappedSize != 0; }
+
+  /// hand the image to the file: unmap, or write() the fallback buffer,
+  /// then rename the staged file over the destination
+  void commit();
+
+  /// the bytes of an inMemory() image, for whoever writes them out instead
+  /// (e.g. utils::IoQueue), the buffer is left empty
+  std::vector<char> release();
+};
+
+} // namespace utils
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef UTILS_SCAN
+#define UTILS_SCAN
+
+#include <array>
+#include <cstdint>
+
+namespace utils {
+namespace scan {
+
+/// character classes of the lexer, the "C" locale regardless of the host's
+enum CharClass : std::uint8_t {
+  kBlank = 1 << 0, ///< ' ', '\t', '\r'
+  kDigit = 1 << 1, ///< 0-9
+  kAlpha = 1 << 2, ///< a-z A-Z
+  kIdent = 1 << 3, ///< alnum, '_' and '.'
+  kHex = 1 << 4,   ///< 0-9 a-f A-F
+};
+
+constexpr std::array<std::uint8_t, 256> makeClasses() {
+  std::array<std::uint8_t, 256> Classes{};
+
+  Classes[' '] = Classes['\t'] = Classes['\r'] = kBlank;
+
+  for (unsigned c = '0'; c <= '9'; ++c) {
+    Classes[c] = kDigit | kIdent | kHex;
+  }
+  for (unsigned c = 'a'; c <= 'z'; ++c) {
+    Classes[c] = kAlpha | kIdent;
+    Classes[c - 'a' + 'A'] = kAlpha | kIdent;
+  }
+  for (unsigned c = 'a'; c <= 'f'; ++c) {
+    Classes[c] |= kHex;
+    Classes[c - 'a' + 'A'] |= kHex;
+  }
+  Classes['_'] = Classes['.'] = kIdent;
+
+  return Classes;
+}
+
+inline constexpr auto Classes = makeClasses();
+
+constexpr bool is(char c, CharClass Class) {
+  return Classes[static_cast<unsigned char>(c)] & Class;
+}
+
+/// the kernels below return the first byte of [Begin, End) that stops the
+/// run (or End), 16 or 32 bytes at a time where the host allows
+
+/// skip ' ', '\t' and '\r'
+const char* skipBlanks(const char* Begin, const char* End);
+
+/// skip to the next '\n'
+const char* findNewline(const char* Begin, const char* End);
+
+/// skip identifier characters (kIdent)
+const char* skipIdent(const char* Begin, const char* End);
+
+/// skip decimal digits
+const char* skipDigits(const char* Begin, const char* End);
+
+/// the kernels picked for this CPU: "avx2", "sse2" or "scalar"
+const char* isa();
+
+} // namespace scan
+} // namespace utils
+
+#endif
@@ -3,13 +3,104 @@
 
 /// TODO: SourceMgr, Dump
 
+#include "utils/ADT/StringRef.hpp"
 #include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
 namespace utils {
 
 struct Location {
   std::size_t line, col;
 };
 
+/// where a token or instruction starts, a byte offset into its source
+/// that wraps past 4 GiB; diagnostics locate the full offset instead
+using SourceLoc = std::uint32_t;
+
+/// line starts of a source, found 16 or 32 bytes at a time
+class LineIndex {
+  /// offset of every line but the first
+  std::vector<std::size_t> Starts;
+
+public:
+  explicit LineIndex(ADT::StringRef Source);
+
+  /// 1-based line and column of the byte at `Offset`
+  Location locate(std::size_t Offset) const;
+};
+
+/// read-only bytes of an input file, borrowed directly by parser::Lexer
+/// regular files are mmapped (zero copy), pipes/ttys fall back to read()
+class SourceBuffer {
+public:
+  using size_ty = std::size_t;
+
+private:
+  const char* Data = nullptr;
+  size_ty Size = 0;
+
+  /// non-zero when Data is a private mapping of the file
+  size_ty MappedSize = 0;
+
+  /// read() fallback storage
+  std::string Owned;
+
+  SourceBuffer() = default;
+
+public:
+  SourceBuffer(const SourceBuffer&) = delete;
+  SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+  SourceBuffer(SourceBuffer&& Other);
+  SourceBuffer& operator=(SourceBuffer&& Other);
+
+  ~SourceBuffer();
+
+  /// open and map `Path`
+  static SourceBuffer open(const char* Path);
+
+  /// open() for paths that come from the user (e.g. .incbin), none when
+  /// `Path` can't be opened or is a directory
+  static std::optional<SourceBuffer> tryOpen(const char* Path);
+
+  /// take over an already opened descriptor, caller keeps ownership of fd
+  static SourceBuffer fromFd(int Fd);
+
+  ADT::StringRef getBuffer() const { return ADT::StringRef(Data, Size); }
+
+  size_ty size() const { return Size; }
+
+  bool isMapped() const { return MappedSize != 0; }
+
+private:
+  void release();
+};
+
+/// forward-only input that can't be mapped up front (e.g. `gnalc -S |`),
+/// bytes are handed out chunk by chunk as the writer produces them
+class SourceStream {
+public:
+  using size_ty = std::size_t;
+
+private:
+  int Fd;
+  bool Eof = false;
+
+public:
+  /// caller keeps ownership of fd
+  explicit SourceStream(int _Fd) : Fd(_Fd) {}
+  SourceStream(const SourceStream&) = delete;
+  SourceStream& operator=(const SourceStream&) = delete;
+
+  /// append at most `Max` bytes to `Buf`, 0 once the input is exhausted
+  size_ty readInto(std::string& Buf, size_ty Max);
+
+  bool atEnd() const { return Eof; }
+};
+
 } // namespace utils
 
 #endif
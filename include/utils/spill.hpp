@@ -0,0 +1,51 @@
+#ifndef UTILS_SPILL
+#define UTILS_SPILL
+
+#include <cstddef>
+#include <vector>
+
+namespace utils {
+
+/// an append-only byte buffer whose head moves to an unlinked temporary
+/// file once it outgrows `Limit`, only the tail stays in memory
+/// bytes already appended may be overwritten and read back wherever they
+/// live
+class SpillBuffer {
+public:
+  using size_ty = std::size_t;
+
+private:
+  /// bytes from Spilled on
+  std::vector<char> Tail;
+  /// bytes already in the file
+  size_ty Spilled = 0;
+  size_ty Limit;
+  int Fd = -1;
+
+  void spill();
+
+public:
+  explicit SpillBuffer(size_ty _Limit = size_ty(64) << 20) : Limit(_Limit) {}
+
+  SpillBuffer(const SpillBuffer&) = delete;
+  SpillBuffer& operator=(const SpillBuffer&) = delete;
+
+  ~SpillBuffer();
+
+  size_ty size() const { return Spilled + Tail.size(); }
+
+  /// bytes that went to the file so far
+  size_ty spilled() const { return Spilled; }
+
+  void append(const void* Data, size_ty N);
+
+  /// overwrite `N` bytes at `Offset`, all of them appended already
+  void write(size_ty Offset, const void* Data, size_ty N);
+
+  /// copy `N` bytes at `Offset` to `Out`, safe to call concurrently
+  void read(size_ty Offset, void* Out, size_ty N) const;
+};
+
+} // namespace utils
+
+#endif
@@ -0,0 +1,130 @@
+#include "driver/Protocol.hpp"
+#include "utils/ADT/StringRef.hpp"
+#include "utils/logger.hpp"
+#include "utils/macro.hpp"
+#include <cerrno>
+#include <climits>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using StringRef = utils::ADT::StringRef;
+namespace protocol = driver::protocol;
+
+/// the daemon runs in its own cwd
+static std::string absolutePath(StringRef Path) {
+  if (Path == "-" || Path.begin_with('/')) {
+    return Path.str();
+  }
+
+  char cwd[PATH_MAX];
+  if (!::getcwd(cwd, sizeof(cwd))) {
+    utils::unreachable("Failed to get working directory");
+  }
+
+  return std::string(cwd) + "/" + Path.str();
+}
+
+/// no daemon around: become the assembler next to this binary
+[[noreturn]] static void runInProcess(const char* Input, const char* Output) {
+  char self[PATH_MAX];
+  auto n = ::readlink("/proc/self/exe", self, sizeof(self) - 1);
+  if (n < 0) {
+    utils::unreachable("Failed to locate the assembler");
+  }
+  self[n] = '\0';
+
+  auto path = std::string(self);
+  path.erase(path.rfind('/') + 1);
+  path += "assembler";
+
+  std::vector<const char*> args{path.c_str(), "-c", Input, "-o", Output,
+                                nullptr};
+  ::execv(path.c_str(), const_cast<char* const*>(args.data()));
+
+  utils::unreachable("Failed to run the assembler");
+}
+
+static void copyStdinTo(int Conn) {
+  std::vector<char> buffer(64 * 1024);
+
+  while (true) {
+    auto n = ::read(STDIN_FILENO, buffer.data(), buffer.size());
+    if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0) {
+      utils::unreachable("Failed to read file");
+    } else if (n == 0 || !protocol::sendAll(Conn, buffer.data(), n)) {
+      break;
+    }
+  }
+}
+
+/// assembler-client [-s <socket>] -c <input> -o <output>
+/// same as `assembler -c <input> -o <output>`, served by a warm
+/// `assembler --daemon` when one listens on the socket
+int main(int argc, char* argv[]) {
+  const char* InputFile = "-";
+  const char* OutputFile = "-";
+  std::string SocketPath = protocol::defaultSocketPath();
+
+  for (int i = 1; i < argc; ++i) {
+    StringRef arg = argv[i];
+
+    if (arg == "-c") {
+      utils_assert(i + 1 < argc, "expecting input file after '-c'");
+      InputFile = argv[++i];
+    } else if (arg == "-o") {
+      utils_assert(i + 1 < argc, "expecting output file after '-o'");
+      OutputFile = argv[++i];
+    } else if (arg == "-s") {
+      utils_assert(i + 1 < argc, "expecting socket path after '-s'");
+      SocketPath = argv[++i];
+    } else {
+      utils::unreachable("unknown argument");
+    }
+  }
+
+  int Conn = protocol::connectTo(SocketPath.c_str());
+  if (Conn < 0) {
+    runInProcess(InputFile, OutputFile);
+  }
+
+  if (!protocol::sendFrame(Conn, absolutePath(InputFile)) ||
+      !protocol::sendFrame(Conn, absolutePath(OutputFile))) {
+    utils::unreachable("assembler daemon hung up");
+  }
+
+  if (StringRef(InputFile) == "-") {
+    copyStdinTo(Conn);
+  }
+  ::shutdown(Conn, SHUT_WR);
+
+  std::string Status, Object;
+  if (!protocol::recvFrame(Conn, Status) ||
+      !protocol::recvFrame(Conn, Object)) {
+    utils::unreachable("assembler daemon hung up");
+  }
+  ::close(Conn);
+
+  if (!Status.empty()) {
+    std::cerr << Status << "\n";
+    return 1;
+  }
+
+  for (std::size_t written = 0; written < Object.size();) {
+    auto n = ::write(STDOUT_FILENO, Object.data() + written,
+                     Object.size() - written);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0) {
+      utils::unreachable("Failed to write file");
+    }
+
+    written += n;
+  }
+
+  return 0;
+}
@@ -0,0 +1,303 @@
+#include "driver/Cache.hpp"
+#include "utils/hash.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+using namespace driver;
+namespace fs = std::filesystem;
+
+namespace {
+/// bump when the layout of the cache directory changes
+constexpr const char* CacheFormat = "rvasm-cache-1";
+
+/// the binary carrying this code: a rebuilt assembler never sees objects of
+/// its predecessor
+const std::string& buildIdentity() {
+  static const std::string Identity = [] {
+    struct stat st{};
+
+    Dl_info info{};
+    if (!::dladdr(reinterpret_cast<void*>(&buildIdentity), &info) ||
+        !info.dli_fname || ::stat(info.dli_fname, &st) != 0) {
+      ::stat("/proc/self/exe", &st);
+    }
+
+    char buffer[128];
+    std::snprintf(buffer, sizeof(buffer), "%s:%ju:%ju:%jd.%09ld", CacheFormat,
+                  std::uintmax_t(st.st_ino), std::uintmax_t(st.st_size),
+                  std::intmax_t(st.st_mtim.tv_sec), st.st_mtim.tv_nsec);
+    return std::string(buffer);
+  }();
+
+  return Identity;
+}
+
+/// unique among the threads and processes sharing a cache
+std::string uniqueSuffix() {
+  static std::atomic<unsigned> Counter = 0;
+  return std::to_string(::getpid()) + "." + std::to_string(Counter++);
+}
+
+std::string toHex(std::uint64_t value) {
+  char buffer[17];
+  std::snprintf(buffer, sizeof(buffer), "%016" PRIx64, value);
+  return buffer;
+}
+
+/// read-modify-write the counters file under an exclusive flock
+template <typename Fn>
+ObjectCache::Stats updateCounters(const std::string& Dir, Fn&& Update) {
+  ObjectCache::Stats stats;
+
+  int fd = ::open((Dir + "/stats").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+  if (fd < 0) {
+    return stats;
+  }
+
+  ::flock(fd, LOCK_EX);
+
+  char buffer[128] = {};
+  if (::pread(fd, buffer, sizeof(buffer) - 1, 0) > 0) {
+    std::sscanf(buffer, "%" SCNu64 " %" SCNu64 " %" SCNu64, &stats.Hits,
+                &stats.Misses, &stats.Bytes);
+  }
+
+  if (Update(stats)) {
+    auto n = std::snprintf(buffer, sizeof(buffer),
+                           "%" PRIu64 " %" PRIu64 " %" PRIu64 "\n", stats.Hits,
+                           stats.Misses, stats.Bytes);
+    if (::pwrite(fd, buffer, n, 0) == n) {
+      ::ftruncate(fd, n);
+    }
+  }
+
+  ::flock(fd, LOCK_UN);
+  ::close(fd);
+
+  return stats;
+}
+
+/// every published entry, objects and fragments alike
+template <typename Fn> void forEachEntry(const std::string& Dir, Fn&& Visit) {
+  for (const auto* kind : {"/objects", "/fragments"}) {
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(Dir + kind, ec);
+         !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+      if (it->is_regular_file(ec)) {
+        Visit(*it);
+      }
+    }
+  }
+}
+} // namespace
+
+ObjectCache::ObjectCache(std::string _Dir, size_ty _MaxSize)
+    : Dir(std::move(_Dir)), MaxSize(_MaxSize) {
+  std::error_code ec;
+  fs::create_directories(Dir + "/objects", ec);
+  fs::create_directories(Dir + "/fragments", ec);
+  fs::create_directories(Dir + "/tmp", ec);
+}
+
+std::string ObjectCache::key(StringRef Source, StringRef Flags) const {
+  auto salt = buildIdentity() + '\0' + Flags.str();
+
+  return toHex(utils::xxhash64(Source, utils::xxhash64(salt, 1))) +
+         toHex(utils::xxhash64(Source, utils::xxhash64(salt, 0)));
+}
+
+std::string ObjectCache::entryPath(StringRef Key) const {
+  auto key = Key.str();
+  return Dir + "/objects/" + key.substr(0, 2) + "/" + key.substr(2) + ".o";
+}
+
+void ObjectCache::record(bool Hit) {
+  updateCounters(Dir, [Hit](Stats& stats) {
+    ++(Hit ? stats.Hits : stats.Misses);
+    return true;
+  });
+}
+
+bool ObjectCache::fetch(StringRef Key, const char* Output) {
+  auto entry = entryPath(Key);
+  auto staged = std::string(Output) + ".tmp." + uniqueSuffix();
+
+  std::error_code ec;
+  if (!fs::exists(entry, ec)) {
+    record(false);
+    return false;
+  }
+
+  /// entries are read-only and never rewritten, sharing the inode is safe
+  fs::create_hard_link(entry, staged, ec);
+  if (ec) {
+    /// e.g. another filesystem
+    ec.clear();
+    fs::copy_file(entry, staged, ec);
+  }
+
+  if (!ec) {
+    fs::rename(staged, Output, ec);
+  }
+
+  if (ec) {
+    fs::remove(staged, ec);
+    record(false);
+    return false;
+  }
+
+  /// LRU: a hit makes the entry young again
+  fs::last_write_time(entry, fs::file_time_type::clock::now(), ec);
+
+  record(true);
+  return true;
+}
+
+void ObjectCache::store(StringRef Key, StringRef Object) {
+  publish(entryPath(Key), Object);
+}
+
+std::string ObjectCache::fragmentPath(StringRef Source, unsigned Align) const {
+  auto key = this->key(Source, "fragment:" + std::to_string(Align));
+  return Dir + "/fragments/" + key.substr(0, 2) + "/" + key.substr(2);
+}
+
+bool ObjectCache::lookup(StringRef Source, unsigned Align,
+                         std::string& Fragment) {
+  auto entry = fragmentPath(Source, Align);
+
+  int fd = ::open(entry.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st{};
+  auto ok = ::fstat(fd, &st) == 0;
+  if (ok) {
+    Fragment.resize(st.st_size);
+    ok = ::pread(fd, Fragment.data(), Fragment.size(), 0) ==
+         static_cast<ssize_t>(Fragment.size());
+  }
+  ::close(fd);
+
+  if (ok) {
+    std::error_code ec;
+    fs::last_write_time(entry, fs::file_time_type::clock::now(), ec);
+  }
+
+  return ok;
+}
+
+void ObjectCache::insert(StringRef Source, unsigned Align,
+                         StringRef Fragment) {
+  publish(fragmentPath(Source, Align), Fragment);
+}
+
+void ObjectCache::publish(const std::string& Entry, StringRef Bytes) {
+  auto entry = fs::path(Entry);
+  auto staged = Dir + "/tmp/" + uniqueSuffix();
+
+  int fd =
+      ::open(staged.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0444);
+  if (fd < 0) {
+    return;
+  }
+
+  auto written = ::write(fd, Bytes.data(), Bytes.size());
+  ::close(fd);
+
+  std::error_code ec;
+  if (written != static_cast<ssize_t>(Bytes.size())) {
+    fs::remove(staged, ec);
+    return;
+  }
+
+  /// readers see either no entry or a complete one; an entry that exists
+  /// holds the same bytes already and is neither replaced nor counted again
+  fs::create_directories(entry.parent_path(), ec);
+  if (::link(staged.c_str(), entry.c_str()) == 0) {
+    Unrecorded += Bytes.size();
+  } else if (errno == EEXIST) {
+    fs::last_write_time(entry, fs::file_time_type::clock::now(), ec);
+  }
+  fs::remove(staged, ec);
+}
+
+void ObjectCache::flush() {
+  auto added = Unrecorded.exchange(0);
+  if (!added) {
+    return;
+  }
+
+  auto stats = updateCounters(Dir, [added](Stats& stats) {
+    stats.Bytes += added;
+    return true;
+  });
+
+  if (stats.Bytes > MaxSize) {
+    trim();
+  }
+}
+
+void ObjectCache::trim() {
+  std::vector<std::tuple<fs::file_time_type, std::uint64_t, fs::path>> entries;
+  std::uint64_t total = 0;
+
+  forEachEntry(Dir, [&](const fs::directory_entry& entry) {
+    std::error_code ec;
+    auto size = entry.file_size(ec);
+    auto time = entry.last_write_time(ec);
+    if (!ec) {
+      entries.emplace_back(time, size, entry.path());
+      total += size;
+    }
+  });
+
+  /// evict below the limit, so the next few stores don't trim again
+  auto target = MaxSize / 10 * 9;
+
+  if (total > MaxSize) {
+    std::error_code ec;
+    std::sort(entries.begin(), entries.end());
+
+    for (const auto& [_, size, path] : entries) {
+      if (total <= target) {
+        break;
+      }
+      if (fs::remove(path, ec)) {
+        total -= size;
+      }
+    }
+  }
+
+  /// concurrent stores may have raced the scan, the next trim corrects it
+  updateCounters(Dir, [total](Stats& stats) {
+    stats.Bytes = total;
+    return true;
+  });
+}
+
+ObjectCache::Stats ObjectCache::stats() const {
+  auto stats = updateCounters(Dir, [](Stats&) { return false; });
+  stats.Entries = stats.Bytes = 0;
+
+  forEachEntry(Dir, [&](const fs::directory_entry& entry) {
+    std::error_code ec;
+    ++stats.Entries;
+    stats.Bytes += entry.file_size(ec);
+  });
+
+  return stats;
+}
@@ -0,0 +1,152 @@
+#include "driver/Daemon.hpp"
+#include "driver/Driver.hpp"
+#include "driver/Protocol.hpp"
+#include "parser/Lexer.hpp"
+#include "utils/ThreadPool.hpp"
+#include "utils/logger.hpp"
+#include "utils/output.hpp"
+#include "utils/source.hpp"
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <format>
+#include <optional>
+#include <semaphore>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace driver;
+
+namespace {
+/// connections served at once, the others wait in the listen backlog
+constexpr std::ptrdiff_t MaxConnections = 64;
+
+/// pause after a transient accept() failure (e.g. EMFILE) before retrying
+constexpr auto AcceptBackoff = std::chrono::milliseconds(100);
+
+/// the peer runs as the daemon's user
+bool fromOwner(int Conn) {
+  struct ucred cred{};
+  socklen_t size = sizeof(cred);
+  return ::getsockopt(Conn, SOL_SOCKET, SO_PEERCRED, &cred, &size) == 0 &&
+         cred.uid == ::getuid();
+}
+
+/// the working directory of the peer, empty when it is gone already
+std::string clientDir(int Conn) {
+  struct ucred cred{};
+  socklen_t size = sizeof(cred);
+  if (::getsockopt(Conn, SOL_SOCKET, SO_PEERCRED, &cred, &size) != 0) {
+    return "";
+  }
+
+  char dir[PATH_MAX];
+  auto link = "/proc/" + std::to_string(cred.pid) + "/cwd";
+  auto n = ::readlink(link.c_str(), dir, sizeof(dir) - 1);
+  return n < 0 ? "" : std::string(dir, n);
+}
+
+/// relative .incbin paths start where the client's would: next to the
+/// input, or in the client's working directory for stdin
+utils::OutputBuffer assembleRequest(int Conn, const std::string& Input,
+                                    const OpenOutput& Open,
+                                    utils::ThreadPool& Pool) {
+  if (Input == "-") {
+    /// lexed while the client is still sending
+    auto SourceStream = utils::SourceStream(Conn);
+    auto Lexer = parser::Lexer(SourceStream);
+    return assemble(Lexer, Open, &Pool, nullptr, false, clientDir(Conn));
+  }
+
+  auto SourceFile = utils::SourceBuffer::open(Input.c_str());
+  auto Lexer = parser::Lexer(SourceFile.getBuffer());
+  return assemble(Lexer, Open, &Pool, nullptr, false, directoryOf(Input));
+}
+
+void handle(int Conn, utils::ThreadPool& Pool) {
+  std::string Input, Output;
+
+  if (!fromOwner(Conn) || !protocol::recvFrame(Conn, Input) ||
+      !protocol::recvFrame(Conn, Output)) {
+    ::close(Conn);
+    return;
+  }
+
+  auto Open = [&Output](std::size_t size) {
+    return Output == "-" ? utils::OutputBuffer::inMemory(size)
+                         : utils::OutputBuffer::create(Output.c_str(), size);
+  };
+
+  /// a bad request fails alone, the daemon keeps serving the others
+  utils::recoverable_scope scope;
+
+  std::string Status;
+  StringRef Bytes;
+  std::optional<utils::OutputBuffer> Object;
+
+  try {
+    Object.emplace(assembleRequest(Conn, Input, Open, Pool));
+
+    if (Output == "-") {
+      Bytes = StringRef(Object->data(), Object->size());
+    } else {
+      Object->commit();
+    }
+  } catch (const std::exception& e) {
+    Status = e.what();
+  }
+
+  /// a client that hung up just misses its answer
+  if (protocol::sendFrame(Conn, Status)) {
+    protocol::sendFrame(Conn, Bytes);
+  }
+
+  ::close(Conn);
+}
+} // namespace
+
+void driver::serve(const char* SocketPath, unsigned ThreadNr) {
+  int Listener = protocol::listenOn(SocketPath);
+
+  /// assembly work only: a worker helping out in TaskGroup::wait() must
+  /// never pick up a connection and block on a slow client
+  utils::ThreadPool Pool(ThreadNr);
+
+  /// a burst of clients queues up instead of spawning a thread each
+  std::counting_semaphore<MaxConnections> Slots(MaxConnections);
+
+  while (true) {
+    Slots.acquire();
+
+    int Conn = ::accept4(Listener, nullptr, nullptr, SOCK_CLOEXEC);
+    if (Conn < 0) {
+      auto err = errno;
+      Slots.release();
+      if (err == EINTR || err == ECONNABORTED) {
+        continue;
+      }
+
+      /// only a broken listener ends the daemon; running out of descriptors
+      /// or memory, or a failed handshake, passes once requests finish
+      if (err == EBADF || err == EINVAL || err == ENOTSOCK ||
+          err == EOPNOTSUPP || err == EFAULT) {
+        utils::error(std::format("Failed to accept connection: {}",
+                                 std::strerror(err)));
+      }
+      utils::warn("Failed to accept connection: {}, retrying",
+                  std::strerror(err));
+      std::this_thread::sleep_for(AcceptBackoff);
+      continue;
+    }
+
+    std::thread([Conn, &Pool, &Slots] {
+      handle(Conn, Pool);
+      Slots.release();
+    }).detach();
+  }
+}
@@ -0,0 +1,422 @@
+#include "driver/Driver.hpp"
+#include "mc/MCContext.hpp"
+#include "parser/Lexer.hpp"
+#include "parser/Parser.hpp"
+#include "parser/TokenStream.hpp"
+#include "utils/IoQueue.hpp"
+#include "utils/ThreadPool.hpp"
+#include "utils/logger.hpp"
+#include "utils/macro.hpp"
+#include "utils/output.hpp"
+#include "utils/source.hpp"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <vector>
+
+using namespace driver;
+
+namespace {
+/// below this an object is filled faster than threads are woken up
+constexpr std::size_t ParallelEmitSize = 1 << 20;
+
+/// from this on a source is lexed on all cores before it is parsed
+constexpr std::size_t ParallelLexSize = 4 << 20;
+
+/// from this on the functions of a source are parsed on all cores first
+constexpr std::size_t ParallelParseSize = 1 << 20;
+
+/// from this on .text is encoded as it is parsed rather than held as
+/// MCInsts, see MCContext::streamText()
+constexpr std::size_t StreamTextSize = std::size_t(1) << 30;
+
+/// the functions of a source, each parsed on its own on a pool
+/// (Parser::parseFunction()) and handed to the serial parse as fragments:
+/// it only stitches them in, in source order, rebasing their offsets and
+/// inner labels. What didn't stand alone (touched .data, left a directive
+/// open, starts at an odd halfword ...) it parses itself, so the object is
+/// the serial one. Other functions are looked up in, and everything the
+/// serial parse records goes to, `Inner`
+class FunctionShards : public mc::FragmentCache {
+  struct Shard {
+    std::size_t Begin, End;
+    std::optional<std::string> Fragment;
+  };
+
+  StringRef Source;
+  mc::FragmentCache* Inner;
+  /// by Begin
+  std::vector<Shard> Shards;
+
+  void parseShard(Shard& S);
+
+public:
+  FunctionShards(StringRef _Source, utils::ThreadPool& Pool,
+                 mc::FragmentCache* _Inner);
+
+  bool empty() const { return Shards.empty(); }
+
+  bool lookup(StringRef Function, unsigned Align,
+              std::string& Fragment) override;
+
+  void insert(StringRef Function, unsigned Align,
+              StringRef Fragment) override {
+    if (Inner) {
+      Inner->insert(Function, Align, Fragment);
+    }
+  }
+};
+
+FunctionShards::FunctionShards(StringRef _Source, utils::ThreadPool& Pool,
+                               mc::FragmentCache* _Inner)
+    : Source(_Source), Inner(_Inner) {
+  auto Scanner = parser::Lexer(Source);
+
+  /// the cuts findFunctionEnd() makes (at `.globl`, `.global` or a section
+  /// directive), a `.globl` one opens a function
+  for (auto at = Scanner.findFunctionEnd(0); at < Source.size();) {
+    auto end = Scanner.findFunctionEnd(at);
+    if (Source[at + 1] == 'g') {
+      Shards.push_back(Shard{at, end, std::nullopt});
+    }
+    at = end;
+  }
+
+  if (Shards.size() < 2) {
+    Shards.clear();
+    return;
+  }
+
+  utils::ThreadPool::TaskGroup Group(Pool);
+  for (auto& S : Shards) {
+    Group.async([this, &S] { parseShard(S); });
+  }
+  Group.wait();
+}
+
+void FunctionShards::parseShard(Shard& S) {
+  auto Function = Source.slice(S.Begin, S.End);
+
+  std::string Fragment;
+  if (Inner && Inner->lookup(Function, 0, Fragment)) {
+    S.Fragment = std::move(Fragment);
+    return;
+  }
+
+  /// an error is left to the serial parse, which reports it in order
+  utils::recoverable_scope Scope;
+  try {
+    auto Lexer = parser::Lexer(Function);
+    auto Ctx = mc::MCContext();
+    S.Fragment = parser::Parser(Ctx, Lexer).parseFunction();
+  } catch (const utils::fatal_error&) {
+    return;
+  }
+
+  if (Inner && S.Fragment) {
+    Inner->insert(Function, 0, *S.Fragment);
+  }
+}
+
+bool FunctionShards::lookup(StringRef Function, unsigned Align,
+                            std::string& Fragment) {
+  auto Begin = static_cast<std::size_t>(Function.data() - Source.data());
+  auto S = std::lower_bound(
+      Shards.begin(), Shards.end(), Begin,
+      [](const Shard& S, std::size_t Offset) { return S.Begin < Offset; });
+
+  auto isShard = Align == 0 && S != Shards.end() && S->Begin == Begin &&
+                 S->End == Begin + Function.size();
+  if (!isShard) {
+    return Inner && Inner->lookup(Function, Align, Fragment);
+  }
+
+  /// each function is stitched in once
+  if (!S->Fragment) {
+    return false;
+  }
+  Fragment = std::move(*S->Fragment);
+  S->Fragment.reset();
+  return true;
+}
+
+utils::OutputBuffer openJobOutput(const Job& job, std::size_t size) {
+  return job.Output == "-"
+             ? utils::OutputBuffer::fromFd(STDOUT_FILENO, size)
+             : utils::OutputBuffer::create(job.Output.c_str(), size);
+}
+
+/// `Source` of `job` into what `Open` hands out, none when the cache put
+/// the object in place already
+std::optional<utils::OutputBuffer>
+assembleSource(const Job& job, StringRef Source, const OpenOutput& Open,
+               utils::ThreadPool* Pool, ObjectCache* Cache) {
+  /// streamed stdout bypasses the cache, and so does a source that pulls
+  /// in other files: the key only covers its own bytes, so such an object
+  /// is never stored and its key never hits
+  std::string Key;
+  if (Cache && job.Output != "-") {
+    Key = Cache->key(Source);
+    if (Cache->fetch(Key, job.Output.c_str())) {
+      return std::nullopt;
+    }
+  }
+
+  /// a huge source is parsed in one bounded pass, nothing is held per
+  /// instruction: no shards, no tokens, no fragments
+  auto StreamText = Source.size() >= StreamTextSize;
+
+  std::optional<utils::ThreadPool> LocalPool;
+  if (Source.size() >= ParallelParseSize && !Pool) {
+    Pool = &LocalPool.emplace();
+  }
+
+  /// a source made of functions is parsed function by function, the
+  /// functions lex themselves; what isn't is lexed up front instead
+  std::optional<FunctionShards> Shards;
+  if (Source.size() >= ParallelParseSize && !StreamText) {
+    Shards.emplace(Source, *Pool, Cache);
+    if (Shards->empty()) {
+      Shards.reset();
+    }
+  }
+
+  std::optional<parser::TokenStream> Tokens;
+  if (!Shards && !StreamText && Source.size() >= ParallelLexSize &&
+      parser::TokenStream::fits(Source)) {
+    Tokens.emplace(Source, Pool);
+  }
+
+  mc::FragmentCache* Fragments = StreamText ? nullptr : Cache;
+  if (Shards) {
+    Fragments = &*Shards;
+  }
+
+  /// borrowed
+  auto Lexer = Tokens ? parser::Lexer(*Tokens) : parser::Lexer(Source);
+  auto IncludeDir = directoryOf(job.Input);
+  auto IncludesFiles = false;
+  auto Output = driver::assemble(Lexer, Open, Pool, Fragments, StreamText,
+                                 IncludeDir, &IncludesFiles);
+
+  if (!Key.empty() && !IncludesFiles) {
+    Cache->store(Key, StringRef(Output.data(), Output.size()));
+  }
+  if (Cache) {
+    Cache->flush();
+  }
+
+  return Output;
+}
+} // namespace
+
+utils::OutputBuffer driver::assemble(parser::Lexer& Lexer,
+                                     const OpenOutput& Open,
+                                     utils::ThreadPool* Pool,
+                                     mc::FragmentCache* Fragments,
+                                     bool StreamText, StringRef IncludeDir,
+                                     bool* IncludesFiles) {
+  auto Ctx = mc::MCContext();
+  if (StreamText || !Lexer.isRandomAccess()) {
+    Ctx.streamText();
+    Fragments = nullptr;
+  }
+  auto Parser = parser::Parser(Ctx, Lexer, Fragments, IncludeDir);
+
+  Parser.parse();
+
+  /// the size is known before a single byte is written: the object is
+  /// filled in place, right inside the (mmapped) output file
+  auto size = Ctx.layout();
+  auto Output = Open(size);
+
+  std::optional<utils::ThreadPool> LocalPool;
+  if (size < ParallelEmitSize) {
+    Pool = nullptr;
+  } else if (!Pool) {
+    Pool = &LocalPool.emplace();
+  }
+
+  Ctx.emit(Output.data(), Pool);
+
+  if (IncludesFiles) {
+    *IncludesFiles = Ctx.includesFiles();
+  }
+
+  return Output;
+}
+
+void driver::assemble(const Job& job, utils::ThreadPool* Pool,
+                      ObjectCache* Cache) {
+  auto Open = [&job](std::size_t size) { return openJobOutput(job, size); };
+
+  if (job.Input == "-") {
+    auto SourceStream = utils::SourceStream(STDIN_FILENO);
+    auto Lexer = parser::Lexer(SourceStream);
+    assemble(Lexer, Open, Pool).commit();
+    return;
+  }
+
+  auto SourceFile = utils::SourceBuffer::open(job.Input.c_str());
+
+  if (auto Output =
+          assembleSource(job, SourceFile.getBuffer(), Open, Pool, Cache)) {
+    Output->commit();
+  }
+}
+
+utils::IoQueue::Stats driver::assembleBatch(const std::vector<Job>& jobs,
+                                            unsigned ThreadNr,
+                                            ObjectCache* Cache,
+                                            unsigned IoDepth) {
+  utils::ThreadPool Pool(ThreadNr);
+
+  if (!IoDepth) {
+    utils::ThreadPool::TaskGroup Group(Pool);
+
+    /// translation units share nothing but the read-only opcode/register
+    /// tables, so the schedule can't change a single output byte
+    for (const auto& job : jobs) {
+      Group.async([&job, &Pool, Cache] { assemble(job, &Pool, Cache); });
+    }
+
+    Group.wait();
+    return {.Backend = "mmap"};
+  }
+
+  utils::IoQueue Io(IoDepth);
+
+  /// a job starting reads ahead up to `IoDepth` jobs past itself; jobs
+  /// start in input order, so at most `IoDepth` sources wait past the ones
+  /// being assembled
+  std::vector<utils::IoQueue::Handle> Reads(jobs.size());
+  std::mutex ReadLock;
+  std::size_t ReadAhead = 0;
+
+  auto prefetch = [&](std::size_t upto) {
+    std::lock_guard guard(ReadLock);
+    for (; ReadAhead < std::min(upto, jobs.size()); ++ReadAhead) {
+      Reads[ReadAhead] = Io.read(jobs[ReadAhead].Input);
+    }
+  };
+
+  prefetch(IoDepth);
+
+  /// the pool pops its own queue LIFO, a task per job would start from the
+  /// last one; runners take the next job off a shared cursor instead
+  std::atomic<std::size_t> Next = 0;
+  auto RunnerNr = std::min<std::size_t>(Pool.size(), jobs.size());
+
+  {
+    utils::ThreadPool::TaskGroup Group(Pool);
+
+    for (std::size_t r = 0; r < RunnerNr; ++r) {
+      Group.async([&] {
+        for (std::size_t i; (i = Next++) < jobs.size();) {
+          prefetch(i + 1 + IoDepth);
+
+          const auto& job = jobs[i];
+          auto Source = Io.wait(Reads[i]);
+          Reads[i].reset();
+
+          /// in memory: the I/O thread writes it behind
+          auto Open = [](std::size_t size) {
+            return utils::OutputBuffer::inMemory(size);
+          };
+
+          if (auto Output = assembleSource(job, Source, Open, &Pool, Cache)) {
+            Io.write(job.Output, Output->release());
+          }
+        }
+      });
+    }
+
+    Group.wait();
+  }
+
+  Io.drain();
+
+  return Io.stats();
+}
+
+std::string driver::objectPathIn(StringRef Dir, StringRef Input) {
+  std::string stem = Input.str();
+
+  if (auto slash = stem.rfind('/'); slash != std::string::npos) {
+    stem.erase(0, slash + 1);
+  }
+
+  if (auto dot = stem.rfind('.'); dot != std::string::npos && dot != 0) {
+    stem.erase(dot);
+  }
+
+  auto path = Dir.str();
+  if (!path.empty() && path.back() != '/') {
+    path.push_back('/');
+  }
+
+  return path + stem + ".o";
+}
+
+std::string driver::directoryOf(StringRef Input) {
+  auto dir = Input.str();
+
+  if (auto slash = dir.rfind('/'); slash == std::string::npos) {
+    dir.clear();
+  } else {
+    dir.erase(slash == 0 ? 1 : slash);
+  }
+
+  return dir;
+}
+
+std::vector<Job> driver::readResponseFile(const char* Path) {
+  auto File = utils::SourceBuffer::open(Path);
+  auto Buffer = File.getBuffer();
+
+  std::vector<Job> jobs;
+  std::vector<std::string> fields;
+  std::string field;
+
+  auto endOfLine = [&]() {
+    if (!field.empty()) {
+      fields.emplace_back(std::move(field));
+      field.clear();
+    }
+
+    utils_assert(fields.empty() || fields.size() == 2,
+                 "expecting '<input> <output>' in response file");
+
+    if (!fields.empty()) {
+      jobs.push_back(Job{std::move(fields[0]), std::move(fields[1])});
+      fields.clear();
+    }
+  };
+
+  for (std::size_t i = 0; i < Buffer.size(); ++i) {
+    char c = Buffer[i];
+
+    if (c == '#') {
+      while (i + 1 < Buffer.size() && Buffer[i + 1] != '\n') {
+        ++i;
+      }
+    } else if (c == '\n') {
+      endOfLine();
+    } else if (c == ' ' || c == '\t' || c == '\r') {
+      if (!field.empty()) {
+        fields.emplace_back(std::move(field));
+        field.clear();
+      }
+    } else {
+      field.push_back(c);
+    }
+  }
+
+  endOfLine();
+
+  return jobs;
+}
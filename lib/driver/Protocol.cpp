@@ -0,0 +1,143 @@
+#include "driver/Protocol.hpp"
+#include "utils/logger.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace driver;
+
+namespace {
+/// frames larger than this are a corrupted stream, not an object
+constexpr std::uint64_t MaxFrameSize = std::uint64_t(1) << 32;
+
+bool makeAddress(const char* Path, sockaddr_un& Addr) {
+  Addr = sockaddr_un{};
+  Addr.sun_family = AF_UNIX;
+
+  if (std::strlen(Path) >= sizeof(Addr.sun_path)) {
+    return false;
+  }
+
+  std::strcpy(Addr.sun_path, Path);
+  return true;
+}
+} // namespace
+
+std::string protocol::defaultSocketPath() {
+  if (auto env = std::getenv("RVASM_SOCKET"); env && *env) {
+    return env;
+  }
+
+  return "/tmp/rvasm-" + std::to_string(::getuid()) + ".sock";
+}
+
+int protocol::connectTo(const char* Path) {
+  sockaddr_un addr;
+  if (!makeAddress(Path, addr)) {
+    return -1;
+  }
+
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+
+  if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    ::close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+int protocol::listenOn(const char* Path) {
+  sockaddr_un addr;
+  if (!makeAddress(Path, addr)) {
+    utils::unreachable("socket path too long");
+  }
+
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    utils::unreachable("Failed to create socket");
+  }
+
+  /// a socket nobody answers on is left over from a dead daemon, one that
+  /// answers belongs to a live daemon and is not taken over
+  if (int probe = connectTo(Path); probe >= 0) {
+    ::close(probe);
+    utils::error(std::format("a daemon already listens on '{}'", Path));
+  } else if (struct stat st{};
+             errno == ECONNREFUSED && ::lstat(Path, &st) == 0 &&
+             S_ISSOCK(st.st_mode)) {
+    ::unlink(Path);
+  }
+
+  if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      ::listen(fd, SOMAXCONN) != 0) {
+    utils::unreachable("Failed to listen on socket");
+  }
+
+  return fd;
+}
+
+bool protocol::sendAll(int Fd, const void* Data, std::size_t Size) {
+  auto bytes = static_cast<const char*>(Data);
+
+  while (Size) {
+    /// a client that went away must not take the daemon down with SIGPIPE
+    auto n = ::send(Fd, bytes, Size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n <= 0) {
+      return false;
+    }
+
+    bytes += n;
+    Size -= n;
+  }
+
+  return true;
+}
+
+bool protocol::recvAll(int Fd, void* Data, std::size_t Size) {
+  auto bytes = static_cast<char*>(Data);
+
+  while (Size) {
+    auto n = ::recv(Fd, bytes, Size, 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n <= 0) {
+      return false;
+    }
+
+    bytes += n;
+    Size -= n;
+  }
+
+  return true;
+}
+
+bool protocol::sendFrame(int Fd, StringRef Data) {
+  std::uint64_t size = Data.size();
+
+  return sendAll(Fd, &size, sizeof(size)) &&
+         sendAll(Fd, Data.data(), Data.size());
+}
+
+bool protocol::recvFrame(int Fd, std::string& Data) {
+  std::uint64_t size = 0;
+
+  if (!recvAll(Fd, &size, sizeof(size)) || size > MaxFrameSize) {
+    return false;
+  }
+
+  Data.resize(size);
+  return recvAll(Fd, Data.data(), size);
+}
@@ -1,44 +1,205 @@
-#include "mc/MCContext.hpp"
+#include "driver/Daemon.hpp"
+#include "driver/Driver.hpp"
+#include "driver/Protocol.hpp"
 #include "parser/Lexer.hpp"
-#include "parser/Parser.hpp"
+#include "utils/ADT/StringRef.hpp"
 #include "utils/logger.hpp"
 #include "utils/macro.hpp"
-#include <cstring>
-#include <fstream>
+#include "utils/source.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
-std::string readFileToString(const std::string& filename) {
-  std::ifstream file(filename, std::ios::binary);
-  if (!file) {
-    utils::unreachable("Failed to open file");
+using StringRef = utils::ADT::StringRef;
+
+/// best of a few rounds of lexing `Path` to its end, nothing is parsed
+static void lexBench(const char* Path) {
+  constexpr int Rounds = 5;
+
+  auto Source = utils::SourceBuffer::open(Path);
+  auto Best = std::chrono::nanoseconds::max();
+  std::uint64_t Tokens = 0;
+
+  for (int round = 0; round < Rounds; ++round) {
+    auto Begin = std::chrono::steady_clock::now();
+    auto Lexer = parser::Lexer(Source.getBuffer());
+    Tokens = 0;
+    while (Lexer.nextToken().type != parser::TokenType::END_OF_FILE) {
+      ++Tokens;
+    }
+    Best = std::min<std::chrono::nanoseconds>(
+        Best, std::chrono::steady_clock::now() - Begin);
   }
 
-  file.seekg(0, std::ios::end);
-  std::size_t size = file.tellg();
-  std::string buffer(size, '\0');
+  auto Seconds = std::chrono::duration<double>(Best).count();
+  std::fprintf(stderr, "%s: lex core %s, %" PRIu64 " tokens, %.1f MiB/s\n",
+               Path, parser::Lexer::core(), Tokens,
+               Source.getBuffer().size() / Seconds / (1 << 20));
+}
 
-  file.seekg(0);
-  file.read(buffer.data(), size);
-  return buffer;
+/// a lone '-' names stdin/stdout, it is not an option
+static bool isOption(StringRef arg) {
+  return (arg.begin_with('-') && arg != "-") || arg.begin_with('@');
 }
 
+/// assembler -c <input> -o <output>      ('-' is stdin / stdout)
+/// gnalc -S ... | assembler > <output>    (filter: stdin to stdout)
+/// assembler [-j <threads>] -c <input>... -d <output dir>
+/// assembler [-j <threads>] @<response file>
+/// assembler [-j <threads>] --daemon [-s <socket>]   (see assembler-client)
+///
+/// --cache <dir> (or $RVASM_CACHE_DIR) reuses objects of unchanged inputs,
+/// --cache-size <MiB> bounds it (default 1024), --cache-stats reports it
+///
+/// --io-depth <N> bounds the reads/writes a batch keeps in flight
+/// (default 16, 0 maps the files instead), --io-stats reports them
+///
+/// --lex-bench only lexes the inputs, a few times, and reports the
+/// throughput of the lexer core this build picked (see Lexer::core())
 int main(int argc, char* argv[]) {
-  std::ofstream OutputFile;
-  std::string SourceFileStr;
+  std::vector<driver::Job> Jobs;
+  std::vector<std::string> Inputs;
+  const char* OutputFile = nullptr;
+  const char* OutputDir = nullptr;
+  unsigned ThreadNr = 0;
+  bool Daemon = false;
+  bool CacheStats = false;
+  unsigned IoDepth = driver::DefaultIoDepth;
+  bool IoStats = false;
+  bool LexBench = false;
+  const char* CacheDir = std::getenv("RVASM_CACHE_DIR");
+  std::size_t CacheSize = 1024;
+  std::string SocketPath = driver::protocol::defaultSocketPath();
+
+  for (int i = 1; i < argc; ++i) {
+    StringRef arg = argv[i];
+
+    if (arg == "-c") {
+      utils_assert(i + 1 < argc, "expecting input file after '-c'");
+      while (i + 1 < argc && !isOption(argv[i + 1])) {
+        Inputs.emplace_back(argv[++i]);
+      }
+    } else if (arg == "-o") {
+      utils_assert(i + 1 < argc, "expecting output file after '-o'");
+      OutputFile = argv[++i];
+    } else if (arg == "-d") {
+      utils_assert(i + 1 < argc, "expecting output directory after '-d'");
+      OutputDir = argv[++i];
+    } else if (arg == "-j") {
+      utils_assert(i + 1 < argc, "expecting thread number after '-j'");
+      ThreadNr = std::stoul(argv[++i]);
+    } else if (arg == "--cache") {
+      utils_assert(i + 1 < argc, "expecting cache directory after '--cache'");
+      CacheDir = argv[++i];
+    } else if (arg == "--cache-size") {
+      utils_assert(i + 1 < argc, "expecting MiB after '--cache-size'");
+      CacheSize = std::stoull(argv[++i]);
+    } else if (arg == "--cache-stats") {
+      CacheStats = true;
+    } else if (arg == "--io-depth") {
+      utils_assert(i + 1 < argc, "expecting queue depth after '--io-depth'");
+      IoDepth = std::stoul(argv[++i]);
+    } else if (arg == "--io-stats") {
+      IoStats = true;
+    } else if (arg == "--lex-bench") {
+      LexBench = true;
+    } else if (arg == "--daemon") {
+      Daemon = true;
+    } else if (arg == "-s") {
+      utils_assert(i + 1 < argc, "expecting socket path after '-s'");
+      SocketPath = argv[++i];
+    } else if (arg.begin_with('@')) {
+      auto rsp = driver::readResponseFile(argv[i] + 1);
+      Jobs.insert(Jobs.end(), rsp.begin(), rsp.end());
+    } else {
+      utils::unreachable("unknown argument");
+    }
+  }
+
+  std::optional<driver::ObjectCache> Cache;
+  if (CacheDir && *CacheDir) {
+    Cache.emplace(CacheDir, CacheSize << 20);
+  }
+
+  if (CacheStats) {
+    utils_assert(Cache, "expecting '--cache' or $RVASM_CACHE_DIR");
+    auto stats = Cache->stats();
+    std::printf("hits %" PRIu64 "\nmisses %" PRIu64 "\nentries %" PRIu64
+                "\nbytes %" PRIu64 "\n",
+                stats.Hits, stats.Misses, stats.Entries, stats.Bytes);
+    return 0;
+  }
 
-  utils_assert(argc == 5, "expecting 4 arguments");
+  if (LexBench) {
+    utils_assert(!Inputs.empty(), "expecting input files after '-c'");
+    for (const auto& input : Inputs) {
+      lexBench(input.c_str());
+    }
+    return 0;
+  }
+
+  if (Daemon) {
+    utils_assert(Inputs.empty() && Jobs.empty(), "a daemon takes no inputs");
+    driver::serve(SocketPath.c_str(), ThreadNr);
+  }
 
-  utils_assert(!std::memcmp(argv[1], "-c", 2), "expecting '-c' argument");
-  SourceFileStr = readFileToString(argv[2]);
-  utils_assert(!std::memcmp(argv[3], "-o", 2), "expecting '-o' argument");
-  OutputFile = std::ofstream(argv[4], std::ios::binary);
+  if (Inputs.empty() && Jobs.empty()) {
+    Inputs.emplace_back("-");
+    if (!OutputFile && !OutputDir) {
+      OutputFile = "-";
+    }
+  }
 
-  auto Lexer = parser::Lexer(SourceFileStr); // source file
-  auto Ctx = mc::MCContext(OutputFile);
-  auto Parser = parser::Parser(Ctx, Lexer);
+  if (OutputFile) {
+    utils_assert(Inputs.size() == 1, "expecting exactly one input with '-o'");
+    Jobs.push_back(driver::Job{Inputs.front(), OutputFile});
+  } else if (OutputDir) {
+    for (const auto& input : Inputs) {
+      Jobs.push_back(
+          driver::Job{input, driver::objectPathIn(OutputDir, input)});
+    }
+  } else {
+    utils_assert(Inputs.empty(), "expecting '-o' or '-d' argument");
+  }
 
-  Parser.parse();
+  utils_assert(!Jobs.empty(), "expecting at least one input file");
 
-  Ctx.writein();
+  for (const auto& job : Jobs) {
+    utils_assert(Jobs.size() == 1 || (job.Input != "-" && job.Output != "-"),
+                 "stdin/stdout can't be shared by a batch");
+  }
+
+  /// jobs run concurrently, two of them (e.g. a/x.s and b/x.s with '-d')
+  /// must not race for one object
+  std::unordered_map<std::string, const driver::Job*> Outputs;
+  for (const auto& job : Jobs) {
+    auto [other, isNew] = Outputs.emplace(job.Output, &job);
+    if (!isNew) {
+      utils::error(std::format("'{}' and '{}' both write '{}'",
+                               other->second->Input, job.Input, job.Output));
+    }
+  }
+
+  if (Jobs.size() == 1) {
+    driver::assemble(Jobs.front(), nullptr, Cache ? &*Cache : nullptr);
+  } else {
+    auto stats = driver::assembleBatch(Jobs, ThreadNr,
+                                       Cache ? &*Cache : nullptr, IoDepth);
+    if (IoStats) {
+      std::fprintf(stderr,
+                   "io backend %s\nio reads %" PRIu64 "\nio writes %" PRIu64
+                   "\nio bytes %" PRIu64 "\nio wait-ms %" PRIu64 "\n",
+                   stats.Backend, stats.Reads, stats.Writes, stats.Bytes,
+                   stats.WaitNs / 1000000);
+    }
+  }
 
   return 0;
-}
\ No newline at end of file
+}
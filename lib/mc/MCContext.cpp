@@ -8,29 +8,125 @@
 #include <iterator>
 #include <string>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 using namespace mc;
 
 bool MCContext::addTextLabel(StringRef Str) {
-  return this->TextLabels.insert(Str, TextOffset);
+  return addTextLabel(Str, TextOffset);
 }
 
 bool MCContext::addTextLabel(StringRef Str, size_ty offset) {
-  return this->TextLabels.insert(Str, std::move(offset));
+  if (!this->TextLabels.insert(Str, offset)) {
+    return false;
+  }
+  if (!Fixups.empty()) {
+    resolveFixups(Str, offset);
+  }
+  return true;
 }
 
 std::string MCContext::buildInnerTextLabel() {
   auto inner_label = ".L" + std::to_string(InnerLabelNr++);
-  this->TextLabels.insert(inner_label.c_str(), TextOffset);
+  if (!this->TextLabels.insert(inner_label.c_str(), TextOffset)) {
+    if (Recording) {
+      /// taken by a label of the source, renumbering would split the two
+      Recording->Cacheable = false;
+    }
+  } else if (!Fixups.empty()) {
+    resolveFixups(inner_label, TextOffset);
+  }
   return inner_label;
 }
 
+void MCContext::streamText(size_ty Limit) {
+  utils_assert(Insts.empty() && !Recording,
+               "streaming .text is decided before anything is added");
+  TextBuffer.emplace(Limit);
+}
+
+void MCContext::flushText() {
+  /// branches/jumps whose label isn't there yet, and the label
+  std::vector<std::pair<const MCInst*, const std::string*>> waiting;
+
+  /// what Relo() does to held insts, their entries stay in program order
+  for (auto& [inst, sym] : ReloInst) {
+    auto [index, isNew] = ReloSymIndex.try_emplace(sym, ReloSyms.size());
+    if (isNew) {
+      ReloSyms.push_back(sym);
+    }
+
+    StreamedRelos.push_back(
+        StreamedRelo{inst->getOffset(),
+                     inst->getExprOp()->getExpr()->getAddend(),
+                     index->second, inst->getRiscvRType(),
+                     inst->isRelaxable()});
+
+    if (!MCExpr::isStaticOffset(inst->getExprTy())) {
+      inst->reloSym(0ll);
+    } else if (auto label = TextLabels.find(sym)) {
+      inst->reloSym(*label - inst->getOffset());
+    } else {
+      waiting.emplace_back(inst, &sym);
+    }
+  }
+
+  /// in the order emit() lays held insts out
+  for (const auto& inst : Insts) {
+    auto size = inst.isCompressed() ? 2 : 4;
+
+    auto fixup = std::find_if(waiting.begin(), waiting.end(), [&](auto& w) {
+      return w.first == &inst;
+    });
+    if (fixup != waiting.end()) {
+      Fixups[*fixup->second].push_back(
+          Fixup{TextBuffer->size(), inst, *inst.getExprOp()->getExpr()});
+      uint32_t hole = 0;
+      TextBuffer->append(&hole, size);
+      continue;
+    }
+
+    auto encode = inst.makeEncoding();
+    TextBuffer->append(&encode, size);
+  }
+
+  Insts.clear();
+  Exprs.clear();
+  ReloInst.clear();
+}
+
+void MCContext::resolveFixups(StringRef Label, size_ty Offset) {
+  auto found = Fixups.find(Label.str());
+  if (found == Fixups.end()) {
+    return;
+  }
+
+  for (auto& fixup : found->second) {
+    /// the inst's own expression went with the statement, use the copy
+    *fixup.Inst.getExprOp() = MCOperand::makeExpr(&fixup.Expr);
+    fixup.Inst.reloSym(Offset - fixup.Inst.getOffset());
+
+    auto encode = fixup.Inst.makeEncoding();
+    TextBuffer->write(fixup.Position, &encode,
+                      fixup.Inst.isCompressed() ? 2 : 4);
+  }
+
+  Fixups.erase(found);
+}
+
 bool MCContext::addReloSym(StringRef Str, size_ty offset, NdxSection ndx) {
-  return this->Symbols.insert({Str.str(), offset, ndx}).second;
+  auto inserted = this->Symbols.insert({Str.str(), offset, ndx}).second;
+  if (inserted && Recording) {
+    Recording->Symbols.emplace_back(Str.str(), offset, ndx);
+  }
+  return inserted;
 }
 
 MCContext::size_ty MCContext::addTextInst(MCInst&& inst) {
+  if (TextBuffer && !OpenInsts) {
+    flushText();
+  }
 
   auto newOffset = incTextOffset(inst.isCompressed());
 
@@ -39,19 +135,20 @@ MCContext::size_ty MCContext::addTextInst(MCInst&& inst) {
   return newOffset;
 }
 
-MCInst* MCContext::newTextInst(const StringRef OpCode LIFETIME_BOUND) {
-  this->Insts.emplace_back(MCInst(OpCode));
-
-  return &this->Insts.back();
-}
-
 MCInst* MCContext::newTextInst(const MCOpCode* OpCode LIFETIME_BOUND) {
+  /// the insts handed out before stay valid up to here
+  if (TextBuffer && !OpenInsts) {
+    flushText();
+  }
+  ++OpenInsts;
+
   this->Insts.emplace_back(MCInst(OpCode));
 
   return &this->Insts.back();
 }
 
 MCContext::size_ty MCContext::commitTextInst() {
+  --OpenInsts;
   auto newOffset = incTextOffset(this->Insts.back().isCompressed());
 
   return newOffset;
@@ -59,6 +156,7 @@ MCContext::size_ty MCContext::commitTextInst() {
 
 MCContext::size_ty MCContext::commitTextInsts(const MCInstPtrs& insts) {
   size_ty newOffset;
+  OpenInsts -= insts.size();
 
   for (auto& inst : insts) {
     inst->modifyOffset(TextOffset);
@@ -85,8 +183,14 @@ void MCContext::mkStrTab() {
     }
   }
 
-  /// find extern symbol in relo insts
-  for (auto& [_, sym] : ReloInst) {
+  /// find extern symbol in relo insts, streamed ones first
+  for (const auto& sym : ReloSyms) {
+    if (!StrTabBuffer.hasSym(sym)) {
+      StrTabBuffer << sym << '\x00';
+      ExternSymbols.insert(sym);
+    }
+  }
+  for (const auto& [_, sym] : ReloInst) {
     if (!StrTabBuffer.hasSym(sym)) {
       StrTabBuffer << sym << '\x00';
       ExternSymbols.insert(sym);
@@ -180,6 +284,34 @@ void MCContext::mkSymtab() {
 /// according to symbol itself
 void MCContext::Relo() {
 
+  /// streamed insts are encoded already (flushText()), only their entries
+  /// are left
+  utils_assert(Fixups.empty(), "branch/jump to an undefined label");
+
+  std::vector<size_ty> streamedSymIdx;
+  for (const auto& sym : ReloSyms) {
+    streamedSymIdx.push_back(std::distance(
+        Elf_Syms.begin(), std::find_if(Elf_Syms.begin(), Elf_Syms.end(),
+                                       [&](const auto& symEntry) {
+                                         return symEntry.first == sym;
+                                       })));
+  }
+
+  for (const auto& relo : StreamedRelos) {
+    auto SymTblIdx = streamedSymIdx[relo.Sym];
+    Elf_Relas.emplace_back(
+        Elf64_Rela{.r_offset = relo.Offset,
+                   .r_info = ELF64_R_INFO(SymTblIdx, relo.Type),
+                   .r_addend = static_cast<Elf64_Sxword>(relo.Addend)});
+
+    if (relo.Relaxable) {
+      Elf_Relas.emplace_back(
+          Elf64_Rela{.r_offset = relo.Offset,
+                     .r_info = ELF64_R_INFO(0, R_RISCV_RELAX),
+                     .r_addend = 0});
+    }
+  }
+
   for (auto [inst, sym] : ReloInst) {
     Elf64_Rela Rela{};
     Rela.r_offset = inst->getOffset();
@@ -195,10 +327,11 @@ void MCContext::Relo() {
 
     Rela.r_addend = inst->getExprOp()->getExpr()->getAddend();
 
-    if (MCExpr::isStaticOffset(inst->getExprTy()))
-      inst->reloSym(*TextLabels.find(sym) -
-                    inst->getOffset()); // offset of the label
-    else
+    if (MCExpr::isStaticOffset(inst->getExprTy())) {
+      auto label = TextLabels.find(sym);
+      utils_assert(label, "branch/jump to an undefined label");
+      inst->reloSym(*label - inst->getOffset()); // offset of the label
+    } else
       inst->reloSym(0ll);
 
     Elf_Relas.emplace_back(std::move(Rela));
@@ -362,7 +495,11 @@ void MCContext::Ehdr_Shdr() {
   }
 }
 
-void MCContext::writein() {
+MCContext::size_ty MCContext::layout() {
+
+  if (TextBuffer) {
+    this->flushText();
+  }
 
   this->mkStrTab();
 
@@ -374,82 +511,146 @@ void MCContext::writein() {
 
   this->Ehdr_Shdr();
 
-  size_ty curOffset = 0;
+  return *this->Offsets.find("section header table") +
+         Elf_Shdrs.size() * sizeof(Elf64_Shdr);
+}
 
-  auto streamWriteIn = [&](const char* data, size_ty n) {
-    this->file.write(data, n);
-    curOffset += n;
+void MCContext::emit(char* Image, utils::ThreadPool* Pool) const {
+  /// gaps between sections are left as they are: Image comes in zeroed
+  auto copyAt = [Image](size_ty offset, const void* data, size_ty n) {
+    if (n) {
+      std::memcpy(Image + offset, data, n);
+    }
   };
 
-  auto padSection = [&](size_ty offset) {
-    /// pad current size to offset
-    std::vector<char> buffer(offset - curOffset, '\x00');
-    streamWriteIn(buffer.data(), buffer.size());
-  };
+  std::vector<utils::ThreadPool::Task> Fills;
 
   /// elf header
   {
-    streamWriteIn((char*)&this->Elf_Ehdr, sizeof(Elf64_Ehdr));
+    Fills.emplace_back(
+        [=, this] { copyAt(0, &this->Elf_Ehdr, sizeof(Elf64_Ehdr)); });
+  }
+
+  /// .text streamed: slices of the encoded bytes
+  if (TextBuffer) {
+    constexpr size_ty SliceSize = 1 << 20;
+
+    auto offset = *this->Offsets.find(".text");
+    auto size = TextBuffer->size();
+
+    for (size_ty begin = 0; begin < size; begin += SliceSize) {
+      auto n = std::min(SliceSize, size - begin);
+      Fills.emplace_back([=, this] {
+        this->TextBuffer->read(begin, Image + offset + begin, n);
+      });
+    }
   }
 
-  /// .text
+  /// .text: slices start at the prefix sum of the instruction sizes
   {
-    padSection(*this->Offsets.find(".text"));
+    constexpr size_ty SliceSize = 16 * 1024;
+
+    auto offset = *this->Offsets.find(".text");
 
-    for (const auto& inst : this->Insts) {
-      auto encode = inst.makeEncoding();
-      streamWriteIn((char*)&encode, inst.isCompressed() ? 2 : 4);
+    for (size_ty begin = 0; begin < this->Insts.size(); begin += SliceSize) {
+      auto end = std::min(begin + SliceSize, this->Insts.size());
+
+      Fills.emplace_back([=, this, offset = offset]() mutable {
+        for (auto i = begin; i < end; ++i) {
+          auto encode = this->Insts[i].makeEncoding();
+          auto size = this->Insts[i].isCompressed() ? 2 : 4;
+          copyAt(offset, &encode, size);
+          offset += size;
+        }
+      });
+
+      for (auto i = begin; i < end; ++i) {
+        offset += this->Insts[i].isCompressed() ? 2 : 4;
+      }
     }
   }
 
   /// .data
   {
-    padSection(*this->Offsets.find(".data"));
-    streamWriteIn((const char*)DataBuffer.data(), DataBuffer.size());
+    Fills.emplace_back([=, this] {
+      copyAt(*this->Offsets.find(".data"), DataBuffer.data(),
+             DataBuffer.size());
+    });
   }
 
   /// .bss
   {
-    padSection(*this->Offsets.find(".bss"));
     /// readelf: Section '.bss' has no data to dump.
   }
 
   /// .symtab
   {
-    padSection(*this->Offsets.find(".symtab"));
-
-    for (auto& [_, symbol] : this->Elf_Syms) {
-      streamWriteIn((char*)&symbol, sizeof(Elf64_Sym));
-    }
+    Fills.emplace_back([=, this] {
+      auto offset = *this->Offsets.find(".symtab");
+
+      for (const auto& [_, symbol] : this->Elf_Syms) {
+        copyAt(offset, &symbol, sizeof(Elf64_Sym));
+        offset += sizeof(Elf64_Sym);
+      }
+    });
   }
 
   /// .strtab
   {
-    padSection(*this->Offsets.find(".strtab"));
-    streamWriteIn((const char*)StrTabBuffer.data(), StrTabBuffer.size());
+    Fills.emplace_back([=, this] {
+      copyAt(*this->Offsets.find(".strtab"), StrTabBuffer.data(),
+             StrTabBuffer.size());
+    });
   }
 
   /// .rela.text
   {
-    padSection(*this->Offsets.find(".rela.text"));
-
-    for (auto& relo : this->Elf_Relas) {
-      streamWriteIn((char*)&relo, sizeof(Elf64_Rela));
-    }
+    Fills.emplace_back([=, this] {
+      copyAt(*this->Offsets.find(".rela.text"), Elf_Relas.data(),
+             Elf_Relas.size() * sizeof(Elf64_Rela));
+    });
   }
 
   /// .shstrtab
   {
-    padSection(*this->Offsets.find(".shstrtab"));
-    streamWriteIn((const char*)SHStrTabBuffer.data(), SHStrTabBuffer.size());
+    Fills.emplace_back([=, this] {
+      copyAt(*this->Offsets.find(".shstrtab"), SHStrTabBuffer.data(),
+             SHStrTabBuffer.size());
+    });
   }
 
   /// dump section headers
   {
-    padSection(*this->Offsets.find("section header table"));
+    Fills.emplace_back([=, this] {
+      copyAt(*this->Offsets.find("section header table"), Elf_Shdrs.data(),
+             Elf_Shdrs.size() * sizeof(Elf64_Shdr));
+    });
+  }
 
-    for (auto& shdr : Elf_Shdrs) {
-      streamWriteIn((char*)&shdr, sizeof(Elf64_Shdr));
+  if (!Pool) {
+    for (auto& fill : Fills) {
+      fill();
     }
+    return;
   }
-}
\ No newline at end of file
+
+  utils::ThreadPool::TaskGroup Group(*Pool);
+
+  for (auto& fill : Fills) {
+    Group.async(std::move(fill));
+  }
+
+  Group.wait();
+}
+
+void MCContext::writein() {
+  utils_assert(this->file, "no output stream to write the object into");
+
+  auto size = this->layout();
+
+  /// one contiguous image, one write
+  std::vector<char> Image(size, '\x00');
+  this->emit(Image.data());
+
+  this->file->write(Image.data(), Image.size());
+}
@@ -0,0 +1,435 @@
+#include "mc/MCContext.hpp"
+#include "mc/MCExpr.hpp"
+#include "mc/MCFragment.hpp"
+#include "mc/MCInst.hpp"
+#include "mc/MCOpCode.hpp"
+#include "mc/MCOperand.hpp"
+#include "utils/macro.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+using namespace mc;
+
+/// fragment layout, integers in host order (a fragment never leaves the
+/// binary that recorded it, see FragmentCache)
+///
+///   u32 magic, u64 .text size, u32 inner labels
+///   u32 insts  { u16 opcode, i64 offset, i64 source offset, u8 flags,
+///                u32 encoding | u8 operands { u8 kind, value } }
+///   u32 labels { sym, i64 offset }
+///   u32 globals { sym, i64 offset }
+///   u32 relos  { u32 inst, sym }
+///
+/// offsets are relative to the start of the function, a sym is
+/// either a string or the n-th `.L<N>` the function built itself, those are
+/// renumbered on replay exactly as buildInnerTextLabel() would
+namespace {
+constexpr uint32_t FragmentMagic = 0x47465652; // "RVFG"
+
+enum FragmentFlag : uint8_t {
+  kRelaxable = 1,
+  kOperands = 2,
+};
+
+/// opcodes travel as their index in the mnemonic table
+const std::vector<const MCOpCode*>& opCodeTable() {
+  static const auto Table = std::apply(
+      [](const auto&... entry) {
+        return std::vector<const MCOpCode*>{entry.second...};
+      },
+      parser::MnemonicMap);
+  return Table;
+}
+
+const std::unordered_map<const MCOpCode*, uint16_t>& opCodeIndex() {
+  static const auto Index = [] {
+    std::unordered_map<const MCOpCode*, uint16_t> index;
+    const auto& table = opCodeTable();
+    for (std::size_t i = 0; i < table.size(); ++i) {
+      index.emplace(table[i], static_cast<uint16_t>(i));
+    }
+    return index;
+  }();
+  return Index;
+}
+
+/// N of a `.L<N>`, the names buildInnerTextLabel() hands out
+std::optional<std::size_t> innerLabelNr(const std::string& Name) {
+  if (Name.size() < 3 || Name.compare(0, 2, ".L") != 0) {
+    return std::nullopt;
+  }
+
+  std::size_t nr = 0;
+  for (auto it = Name.begin() + 2; it != Name.end(); ++it) {
+    if (!std::isdigit(static_cast<unsigned char>(*it))) {
+      return std::nullopt;
+    }
+    nr = nr * 10 + (*it - '0');
+  }
+
+  return nr;
+}
+
+class FragmentWriter {
+  std::string Out;
+
+public:
+  template <typename T> void put(T Value) {
+    Out.append(reinterpret_cast<const char*>(&Value), sizeof(T));
+  }
+
+  void putStr(const std::string& Str) {
+    put<uint32_t>(Str.size());
+    Out.append(Str);
+  }
+
+  std::string take() { return std::move(Out); }
+};
+
+class FragmentReader {
+  const char* Cur;
+  const char* End;
+  bool Ok = true;
+
+public:
+  explicit FragmentReader(StringRef Fragment)
+      : Cur(Fragment.data()), End(Fragment.data() + Fragment.size()) {}
+
+  template <typename T> T get() {
+    T value{};
+    if (static_cast<std::size_t>(End - Cur) < sizeof(T)) {
+      Ok = false;
+      return value;
+    }
+
+    std::memcpy(&value, Cur, sizeof(T));
+    Cur += sizeof(T);
+    return value;
+  }
+
+  std::string getStr() {
+    auto size = get<uint32_t>();
+    if (static_cast<std::size_t>(End - Cur) < size) {
+      Ok = false;
+      return {};
+    }
+
+    std::string str(Cur, size);
+    Cur += size;
+    return str;
+  }
+
+  void fail() { Ok = false; }
+  bool ok() const { return Ok; }
+  bool atEnd() const { return Cur == End; }
+};
+} // namespace
+
+void MCContext::beginFragment() {
+  utils_assert(!Recording, "fragments don't nest");
+  utils_assert(!TextBuffer, "fragments are recorded from held insts only");
+
+  Recording = FragmentMark{
+      .Insts = Insts.size(),
+      .Relos = ReloInst.size(),
+      .Labels = TextLabels.keys().size(),
+      .TextOffset = TextOffset,
+      .InnerLabelNr = InnerLabelNr,
+      .DataSize = DataBuffer.size(),
+      .DataVars = DataVariables.keys().size(),
+      .BssSize = BssSize,
+      .BssVars = BssVariables.keys().size(),
+  };
+}
+
+std::optional<std::string> MCContext::endFragment(size_ty Source) {
+  utils_assert(Recording, "no fragment is being recorded");
+
+  auto mark = std::move(*Recording);
+  Recording.reset();
+
+  if (!mark.Cacheable || DataBuffer.size() != mark.DataSize ||
+      DataVariables.keys().size() != mark.DataVars ||
+      BssSize != mark.BssSize || BssVariables.keys().size() != mark.BssVars) {
+    return std::nullopt;
+  }
+
+  FragmentWriter w;
+  bool cacheable = true;
+
+  auto putSym = [&](const std::string& Sym) {
+    if (auto nr = innerLabelNr(Sym)) {
+      if (*nr >= mark.InnerLabelNr && *nr < InnerLabelNr) {
+        w.put<uint8_t>(1);
+        w.put<uint32_t>(*nr - mark.InnerLabelNr);
+        return;
+      }
+
+      /// somebody else's `.L<N>`, its number is not ours to keep
+      cacheable = false;
+    }
+
+    w.put<uint8_t>(0);
+    w.putStr(Sym);
+  };
+
+  auto relative = [&](size_ty Offset) {
+    return static_cast<int64_t>(Offset - mark.TextOffset);
+  };
+
+  w.put(FragmentMagic);
+  w.put<uint64_t>(TextOffset - mark.TextOffset);
+  w.put<uint32_t>(InnerLabelNr - mark.InnerLabelNr);
+
+  /// insts Relo() patches keep their operands, the others are encoded now
+  std::unordered_map<const MCInst*, uint32_t> index;
+  std::vector<bool> keepOperands(Insts.size() - mark.Insts, false);
+
+  for (auto i = mark.Insts; i < Insts.size(); ++i) {
+    index.emplace(&Insts[i], i - mark.Insts);
+    keepOperands[i - mark.Insts] = std::any_of(
+        Insts[i].begin(), Insts[i].end(),
+        [](const MCOperand& op) { return op.isExpr() || op.isInst(); });
+  }
+
+  for (auto i = mark.Relos; i < ReloInst.size(); ++i) {
+    auto found = index.find(std::get<0>(ReloInst[i]));
+    if (found == index.end()) {
+      return std::nullopt;
+    }
+    keepOperands[found->second] = true;
+  }
+
+  w.put<uint32_t>(Insts.size() - mark.Insts);
+  for (auto i = mark.Insts; i < Insts.size(); ++i) {
+    const auto& inst = Insts[i];
+    auto keep = keepOperands[i - mark.Insts];
+
+    w.put<uint16_t>(opCodeIndex().at(inst.getOpCode()));
+    w.put<int64_t>(relative(inst.getOffset()));
+    w.put<int64_t>(static_cast<int64_t>(inst.getLoc()) -
+                   static_cast<int64_t>(Source));
+    w.put<uint8_t>((inst.isRelaxable() ? kRelaxable : 0) |
+                   (keep ? kOperands : 0));
+
+    if (!keep) {
+      w.put<uint32_t>(inst.makeEncoding());
+      continue;
+    }
+
+    w.put<uint8_t>(inst.getOpSize());
+    for (const auto& op : inst) {
+      w.put<uint8_t>(op.Kind);
+
+      switch (op.Kind) {
+      case MCOperand::kReg:
+        w.put<uint8_t>(op.Reg);
+        break;
+      case MCOperand::kImme:
+      case MCOperand::kRoundMode:
+        w.put<int64_t>(op.Imm);
+        break;
+      case MCOperand::kSFPImme:
+        w.put<uint32_t>(op.SFPImm);
+        break;
+      case MCOperand::kDFPImme:
+        w.put<uint64_t>(op.DFPImm);
+        break;
+      case MCOperand::kExpr:
+        w.put<uint8_t>(op.Expr->getModifier());
+        putSym(op.Expr->getSym().str());
+        w.put<uint64_t>(op.Expr->getAddend());
+        break;
+      default:
+        /// sub-instructions point outside the fragment
+        return std::nullopt;
+      }
+    }
+  }
+
+  const auto& labels = TextLabels.keys();
+  w.put<uint32_t>(labels.size() - mark.Labels);
+  for (auto i = mark.Labels; i < labels.size(); ++i) {
+    putSym(labels[i]);
+    w.put<int64_t>(relative(*TextLabels.find(labels[i])));
+  }
+
+  w.put<uint32_t>(mark.Symbols.size());
+  for (const auto& [sym, offset, ndx] : mark.Symbols) {
+    if (ndx != text) {
+      return std::nullopt;
+    }
+    putSym(sym);
+    w.put<int64_t>(relative(offset));
+  }
+
+  w.put<uint32_t>(ReloInst.size() - mark.Relos);
+  for (auto i = mark.Relos; i < ReloInst.size(); ++i) {
+    const auto& [inst, sym] = ReloInst[i];
+    w.put<uint32_t>(index.at(inst));
+    putSym(sym);
+  }
+
+  if (!cacheable) {
+    return std::nullopt;
+  }
+
+  return w.take();
+}
+
+bool MCContext::injectFragment(StringRef Fragment, size_ty Source) {
+  utils_assert(!Recording, "replaying a fragment while recording one");
+  utils_assert(!TextBuffer, "fragments are replayed into held insts only");
+
+  FragmentReader r(Fragment);
+
+  if (r.get<uint32_t>() != FragmentMagic) {
+    return false;
+  }
+
+  auto textSize = r.get<uint64_t>();
+  auto innerLabels = r.get<uint32_t>();
+
+  auto getSym = [&]() -> std::string {
+    if (!r.get<uint8_t>()) {
+      return r.getStr();
+    }
+
+    auto nr = r.get<uint32_t>();
+    if (nr >= innerLabels) {
+      r.fail();
+    }
+    return ".L" + std::to_string(InnerLabelNr + nr);
+  };
+
+  auto absolute = [&](int64_t Offset) {
+    return static_cast<size_ty>(TextOffset + Offset);
+  };
+
+  /// insts go in right away, they are taken back if the rest is malformed
+  auto firstInst = Insts.size();
+  auto firstExpr = Exprs.size();
+
+  auto rollback = [&] {
+    while (Insts.size() > firstInst) {
+      Insts.pop_back();
+    }
+    while (Exprs.size() > firstExpr) {
+      Exprs.pop_back();
+    }
+    return false;
+  };
+
+  const auto& opCodes = opCodeTable();
+
+  auto instNr = r.get<uint32_t>();
+  for (uint32_t i = 0; i < instNr && r.ok(); ++i) {
+    auto opCode = r.get<uint16_t>();
+    auto offset = absolute(r.get<int64_t>());
+    auto loc = static_cast<SourceLoc>(Source + r.get<int64_t>());
+    auto flags = r.get<uint8_t>();
+
+    if (opCode >= opCodes.size()) {
+      return rollback();
+    }
+
+    if (!(flags & kOperands)) {
+      Insts.emplace_back(opCodes[opCode], loc, offset, r.get<uint32_t>());
+      continue;
+    }
+
+    auto& inst = Insts.emplace_back(opCodes[opCode], loc, offset);
+    if (flags & kRelaxable) {
+      inst.relax();
+    }
+
+    auto opNr = r.get<uint8_t>();
+    if (opNr > 6) {
+      return rollback();
+    }
+
+    for (uint8_t j = 0; j < opNr && r.ok(); ++j) {
+      auto kind = r.get<uint8_t>();
+
+      switch (kind) {
+      case MCOperand::kReg:
+        inst.addOperand(MCOperand::makeReg(r.get<uint8_t>()));
+        break;
+      case MCOperand::kImme:
+        inst.addOperand(MCOperand::makeImm(r.get<int64_t>()));
+        break;
+      case MCOperand::kRoundMode:
+        inst.addOperand(MCOperand::makeRm(r.get<int64_t>()));
+        break;
+      case MCOperand::kSFPImme:
+        inst.addOperand(MCOperand::makeSFPImm(r.get<uint32_t>()));
+        break;
+      case MCOperand::kDFPImme:
+        inst.addOperand(MCOperand::makeDFPImm(r.get<uint64_t>()));
+        break;
+      case MCOperand::kExpr: {
+        auto ty = static_cast<MCExpr::ExprTy>(r.get<uint8_t>());
+        auto sym = getSym();
+        auto append = r.get<uint64_t>();
+        inst.addOperand(MCOperand::makeExpr(getTextExpr(sym, ty, append)));
+      } break;
+      default:
+        return rollback();
+      }
+    }
+  }
+
+  std::vector<std::tuple<std::string, size_ty>> labels, globals;
+  std::vector<std::tuple<uint32_t, std::string>> relos;
+
+  auto labelNr = r.get<uint32_t>();
+  for (uint32_t i = 0; i < labelNr && r.ok(); ++i) {
+    auto sym = getSym();
+    labels.emplace_back(std::move(sym), absolute(r.get<int64_t>()));
+  }
+
+  auto globalNr = r.get<uint32_t>();
+  for (uint32_t i = 0; i < globalNr && r.ok(); ++i) {
+    auto sym = getSym();
+    globals.emplace_back(std::move(sym), absolute(r.get<int64_t>()));
+  }
+
+  auto reloNr = r.get<uint32_t>();
+  for (uint32_t i = 0; i < reloNr && r.ok(); ++i) {
+    auto inst = r.get<uint32_t>();
+    if (inst >= instNr) {
+      r.fail();
+    }
+    relos.emplace_back(inst, getSym());
+  }
+
+  if (!r.ok() || !r.atEnd()) {
+    return rollback();
+  }
+
+  /// the source may have changed around the function: clashes are
+  /// reported just like a fresh parse reports them
+  for (auto& [label, offset] : labels) {
+    utils_assert(TextLabels.insert(label, offset), "text label redefinition!");
+  }
+
+  for (auto& [sym, offset] : globals) {
+    utils_assert(addReloSym(sym, offset, text), "global symbol redefinition");
+  }
+
+  for (auto& [inst, sym] : relos) {
+    addReloInst(&Insts[firstInst + inst], std::move(sym));
+  }
+
+  TextOffset += textSize;
+  InnerLabelNr += innerLabels;
+
+  return true;
+}
@@ -110,11 +110,13 @@ uint32_t MCInst::getRiscvRType() const {
 
 using MCInsts = utils::ADT::SmallVector<MCInst, 4>;
 
-MCInsts MCInst::makeLi(Location Loc, size_ty Offset, StringRef target,
+MCInsts MCInst::makeLi(SourceLoc Loc, size_ty Offset, StringRef target,
                        int64_t imme) {
   MCInsts insts{};
 
-  auto reg = *Registers.find(target);
+  auto found = Registers.find(target);
+  utils_assert(found, "invalid register literal");
+  auto reg = *found;
 
   auto addi_able = [](int64_t imme) -> bool {
     return utils::in_interval<true, true, int64_t>(-2048, 2047, imme);
@@ -123,7 +125,7 @@ MCInsts MCInst::makeLi(Location Loc, size_ty Offset, StringRef target,
   auto load32 = [&](int64_t imme) {
     if (addi_able(imme)) {
       /// addi x<>, x0, imme
-      auto addi = MCInst(parser::MnemonicFind("addi"), Loc, Offset += 4);
+      auto addi = MCInst(&ADDI, Loc, Offset += 4);
       addi.addOperands(*Registers.find(target), *Registers.find("x0"), imme);
 
       insts.emplace_back(std::move(addi));
@@ -132,26 +134,26 @@ MCInsts MCInst::makeLi(Location Loc, size_ty Offset, StringRef target,
       int64_t high20 = imme - (imme & 0xFFF), low12 = imme & 0xFFF;
 
       if (high20) {
-        auto lui = MCInst(parser::MnemonicFind("lui"), Loc, Offset += 4);
+        auto lui = MCInst(&LUI, Loc, Offset += 4);
         lui.addOperands(reg, int64_t(high20 + (low12 > 0x800 ? 0x1000 : 0)));
         insts.emplace_back(std::move(lui));
       } else {
-        auto mv = MCInst(parser::MnemonicFind("addi"), Loc, Offset += 4);
+        auto mv = MCInst(&ADDI, Loc, Offset += 4);
         mv.addOperands(reg, *Registers.find("x0"), (int64_t)0);
         insts.emplace_back(std::move(mv));
       }
 
       if (low12 < 0x800) {
         /// addi x<>, x<>,%lo(imme)
-        auto addi = MCInst(parser::MnemonicFind("addi"), Loc, Offset += 4);
+        auto addi = MCInst(&ADDI, Loc, Offset += 4);
         addi.addOperands(reg, reg, int64_t(low12));
 
         insts.emplace_back(std::move(addi));
       } else {
-        auto addi_0 = MCInst(parser::MnemonicFind("addi"), Loc, Offset += 4);
+        auto addi_0 = MCInst(&ADDI, Loc, Offset += 4);
         addi_0.addOperands(reg, reg, int64_t(0x7FF));
 
-        auto addi_1 = MCInst(parser::MnemonicFind("addi"), Loc, Offset += 4);
+        auto addi_1 = MCInst(&ADDI, Loc, Offset += 4);
         addi_1.addOperands(reg, reg, int64_t(low12 - 0x7FF));
 
         insts.emplace_back(std::move(addi_0));
@@ -163,7 +165,7 @@ MCInsts MCInst::makeLi(Location Loc, size_ty Offset, StringRef target,
   load32(imme & 0xFFFFFFFF);
 
   if (utils::clz_wrapper((uint64_t)imme) < 32) {
-    auto slli = MCInst(parser::MnemonicFind("slli"), Loc, Offset += 4);
+    auto slli = MCInst(&SLLI, Loc, Offset += 4);
     slli.addOperands(reg, reg, (int64_t)32);
     load32(imme >> 32);
   }
@@ -172,6 +174,10 @@ MCInsts MCInst::makeLi(Location Loc, size_ty Offset, StringRef target,
 }
 
 uint32_t MCInst::makeEncoding() const {
+  if (Encoded) {
+    return *Encoded;
+  }
+
   auto& pattern = OpCode->encodings;
 
   struct Bits {
@@ -0,0 +1,231 @@
+#include "parser/Keyword.hpp"
+#include "mc/MCExpr.hpp"
+#include "mc/MCOpCode.hpp"
+#include "mc/Pseudo.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+using namespace parser;
+
+namespace {
+/// RISCV.def and Pseudo.def, then the rest
+template <std::size_t... I>
+constexpr auto mnemonics(std::index_sequence<I...>) {
+  return std::array{Keyword{
+      StringRef(std::get<I>(MnemonicMap).first.data(),
+                std::get<I>(MnemonicMap).first.size() - 1),
+      Keyword::kMnemonic, 0, std::get<I>(MnemonicMap).second, nullptr}...};
+}
+
+template <std::size_t... I> constexpr auto pseudos(std::index_sequence<I...>) {
+  return std::array{
+      Keyword{StringRef(std::get<I>(PseudoMap).first.data(),
+                        std::get<I>(PseudoMap).first.size() - 1),
+              Keyword::kPseudo, 0, nullptr, std::get<I>(PseudoMap).second}...};
+}
+
+constexpr auto Mnemonics = mnemonics(
+    std::make_index_sequence<std::tuple_size_v<decltype(MnemonicMap)>>{});
+
+constexpr auto Pseudos = pseudos(
+    std::make_index_sequence<std::tuple_size_v<decltype(PseudoMap)>>{});
+
+#define REGISTER(name, number) Keyword{#name, Keyword::kRegister, number},
+#define ROUND_MODE(name, bits) Keyword{#name, Keyword::kMode, bits},
+constexpr Keyword Others[] = {
+#include "mc/Registers.def"
+
+    Keyword{"li", Keyword::kLi},
+
+#define DIRECTIVE(name, directive)                                             \
+  Keyword{name, Keyword::kDirective, static_cast<std::uint8_t>(directive)}
+    DIRECTIVE(".text", Directive::kText),
+    DIRECTIVE(".data", Directive::kData),
+    DIRECTIVE(".bss", Directive::kBss),
+    DIRECTIVE(".globl", Directive::kGlobl),
+    DIRECTIVE(".global", Directive::kGlobl),
+    DIRECTIVE(".half", Directive::kHalf),
+    DIRECTIVE(".word", Directive::kWord),
+    DIRECTIVE(".dword", Directive::kDword),
+    DIRECTIVE(".align", Directive::kAlign),
+    DIRECTIVE(".balign", Directive::kBalign),
+    DIRECTIVE(".zero", Directive::kZero),
+    DIRECTIVE(".space", Directive::kSpace),
+    DIRECTIVE(".float", Directive::kFloat),
+    DIRECTIVE(".double", Directive::kDouble),
+    DIRECTIVE(".fill", Directive::kFill),
+    DIRECTIVE(".incbin", Directive::kIncbin),
+#undef DIRECTIVE
+
+#define MODIFIER(name, ty) Keyword{name, Keyword::kModifier, mc::MCExpr::ty}
+    MODIFIER("%lo", kLO),
+    MODIFIER("%hi", kHI),
+    MODIFIER("%pcrel_lo", kPCREL_LO),
+    MODIFIER("%pcrel_hi", kPCREL_HI),
+    MODIFIER("%got_pcrel_hi", kGOT_PCREL_HI),
+    MODIFIER("%tprel_add", kTPREL_ADD),
+    MODIFIER("%tprel_hi", kTPREL_HI),
+    MODIFIER("%tls_ie_pcrel_hi", kTLS_IE_PCREL_HI),
+    MODIFIER("%tls_gd_pcrel_hi", kTLS_GD_PCREL_HI),
+#undef MODIFIER
+};
+
+constexpr std::size_t MaxKeywords =
+    Mnemonics.size() + Pseudos.size() + std::size(Others);
+
+/// hash and displace: a word picks a bucket, the bucket's seed places all
+/// of its words in distinct slots; a lookup is one hash, one seed and one
+/// compare
+constexpr std::size_t BucketBits = 8;
+constexpr std::size_t SlotBits = 10;
+constexpr std::size_t Buckets = std::size_t(1) << BucketBits;
+constexpr std::size_t Slots = std::size_t(1) << SlotBits;
+static_assert(MaxKeywords < Slots / 2, "keep the table sparse");
+
+/// FNV-1a
+constexpr std::uint64_t hash(StringRef Word) {
+  std::uint64_t Hash = 14695981039346656037ull;
+  for (auto c : Word) {
+    Hash = (Hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+  }
+  return Hash;
+}
+
+constexpr std::size_t bucket(std::uint64_t Hash) {
+  return Hash & (Buckets - 1);
+}
+
+constexpr std::size_t slot(std::uint64_t Hash, std::uint16_t Seed) {
+  auto Mixed = (Hash ^ (Seed * 0x9e3779b97f4a7c15ull)) * 0xff51afd7ed558ccdull;
+  return Mixed >> (64 - SlotBits);
+}
+
+struct Table {
+  std::array<Keyword, MaxKeywords> Entries{};
+  std::array<std::uint16_t, Buckets> Seeds{};
+  /// index into Entries, Empty for none
+  std::array<std::uint16_t, Slots> Index{};
+
+  static constexpr std::uint16_t Empty = 0xffff;
+};
+
+constexpr Table build() {
+  Table T;
+  std::array<std::uint64_t, MaxKeywords> Hashes{};
+  std::size_t Size = 0;
+
+  auto add = [&](const Keyword& K) {
+    Hashes[Size] = hash(K.Name);
+    T.Entries[Size++] = K;
+  };
+
+  for (const auto& K : Mnemonics) {
+    add(K);
+  }
+
+  /// a pseudo sharing its name with a mnemonic joins its entry
+  for (const auto& P : Pseudos) {
+    auto Hash = hash(P.Name);
+    auto Joined = false;
+    for (std::size_t i = 0; !Joined && i < Mnemonics.size(); ++i) {
+      if (Hashes[i] == Hash && T.Entries[i].Name == P.Name) {
+        T.Entries[i].Kinds |= Keyword::kPseudo;
+        T.Entries[i].Pseudo = P.Pseudo;
+        Joined = true;
+      }
+    }
+    if (!Joined) {
+      add(P);
+    }
+  }
+
+  for (const auto& K : Others) {
+    add(K);
+  }
+
+  /// entries grouped by bucket
+  std::array<std::uint16_t, Buckets + 1> First{};
+  for (std::size_t i = 0; i < Size; ++i) {
+    ++First[bucket(Hashes[i]) + 1];
+  }
+  for (std::size_t b = 0; b < Buckets; ++b) {
+    First[b + 1] += First[b];
+  }
+
+  std::array<std::uint16_t, MaxKeywords> Order{};
+  auto Fill = First;
+  for (std::size_t i = 0; i < Size; ++i) {
+    Order[Fill[bucket(Hashes[i])]++] = static_cast<std::uint16_t>(i);
+  }
+
+  for (auto& Index : T.Index) {
+    Index = Table::Empty;
+  }
+
+  std::size_t Largest = 0;
+  for (std::size_t b = 0; b < Buckets; ++b) {
+    Largest = std::max<std::size_t>(Largest, First[b + 1] - First[b]);
+  }
+
+  constexpr std::size_t MaxBucket = 16;
+  if (Largest > MaxBucket) {
+    throw "a bucket too crowded, widen BucketBits";
+  }
+
+  /// crowded buckets first, while most slots are free
+  for (auto Count = Largest; Count > 0; --Count) {
+    for (std::size_t b = 0; b < Buckets; ++b) {
+      if (First[b + 1] - First[b] != Count) {
+        continue;
+      }
+
+      for (std::uint16_t Seed = 0;; ++Seed) {
+        std::array<std::size_t, MaxBucket> Taken{};
+        auto Placed = true;
+
+        for (std::size_t k = 0; Placed && k < Count; ++k) {
+          auto s = slot(Hashes[Order[First[b] + k]], Seed);
+          Placed = T.Index[s] == Table::Empty;
+          for (std::size_t j = 0; Placed && j < k; ++j) {
+            Placed = Taken[j] != s;
+          }
+          Taken[k] = s;
+        }
+
+        if (Placed) {
+          T.Seeds[b] = Seed;
+          for (std::size_t k = 0; k < Count; ++k) {
+            T.Index[Taken[k]] = Order[First[b] + k];
+          }
+          break;
+        }
+      }
+    }
+  }
+
+  return T;
+}
+
+constexpr Table Keywords = build();
+} // namespace
+
+const Keyword* parser::findKeyword(StringRef Word) {
+  auto Hash = hash(Word);
+  auto Index = Keywords.Index[slot(Hash, Keywords.Seeds[bucket(Hash)])];
+
+  if (Index == Table::Empty || !(Keywords.Entries[Index].Name == Word)) {
+    return nullptr;
+  }
+  return &Keywords.Entries[Index];
+}
+
+std::uint16_t parser::keywordIndex(const Keyword* K) {
+  return static_cast<std::uint16_t>(K - Keywords.Entries.data());
+}
+
+const Keyword* parser::keywordAt(std::uint16_t Index) {
+  return &Keywords.Entries[Index];
+}
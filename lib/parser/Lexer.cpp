@@ -1,11 +1,13 @@
 #include "parser/Lexer.hpp"
-#include "mc/MCOpCode.hpp"
-#include "mc/MCOperand.hpp"
-#include "mc/Pseudo.hpp"
+#include "parser/TokenStream.hpp"
 #include "utils/likehood.hpp"
+#include "utils/scan.hpp"
 #include <algorithm>
-#include <cctype>
+#include <bit>
+#include <charconv>
 #include <cstddef>
+#include <cstring>
+#include <limits>
 #include <string>
 
 namespace parser {
@@ -57,18 +59,70 @@ std::string to_string(TokenType type) {
 
 using namespace parser;
 
+const char* Lexer::core() {
+#ifdef RVASM_TABLE_LEXER
+  return "table";
+#else
+  return "branchy";
+#endif
+}
+
 void Token::print() const {
   std::cout << "Token(" << to_string(type) << ", lexeme: '" << lexeme << "', "
-            << "line: " << loc.line << ", col: " << loc.col << ")\n";
+            << "offset: " << loc << ")\n";
 }
 
 Lexer::Lexer(StringRef source) : m_source(source) {}
 
+Lexer::Lexer(utils::SourceStream& source) : m_stream(&source) {}
+
+Lexer::Lexer(const TokenStream& tokens)
+    : m_source(tokens.source()), m_tokens(&tokens) {}
+
+void Lexer::fill() {
+  /// tokens never cross a line, a complete line ahead is all we need
+  if (!m_stream || m_cursor < m_complete || m_stream->atEnd()) {
+    return;
+  }
+
+  /// everything before the cursor is tokenized already
+  auto keep = m_cursor;
+
+  /// tokens view the window: the next one is built aside, this one lives on
+  /// until the fill after the parser moved past its lines
+  std::string next;
+  if (!m_retired.empty()) {
+    next = std::move(m_retired.back());
+    m_retired.clear();
+  }
+  next.assign(m_window, keep);
+  m_retired.push_back(std::move(m_window));
+  m_window = std::move(next);
+
+  m_dropped += keep;
+  m_cursor -= keep;
+
+  constexpr std::size_t ChunkSize = 64 * 1024;
+
+  while (m_stream->readInto(m_window, ChunkSize)) {
+    auto newline = m_window.rfind('\n');
+    if (newline != std::string::npos && newline >= m_cursor) {
+      m_complete = newline + 1;
+      break;
+    }
+  }
+
+  if (m_stream->atEnd()) {
+    m_complete = m_window.size();
+  }
+
+  m_source = StringRef(m_window.data(), m_window.size());
+}
+
 bool Lexer::isAtEnd() const { return m_cursor >= m_source.size(); }
 
 char Lexer::advance() {
   if (!isAtEnd()) {
-    m_col++;
     return m_source[m_cursor++];
   }
   return '\0';
@@ -93,12 +147,10 @@ void Lexer::skipWhitespaceAndComments() {
     case ' ':
     case '\r':
     case '\t':
-      advance();
+      advanceTo(utils::scan::skipBlanks(cursor(), end()));
       break;
     case '#': // Comment goes to the end of the line
-      while (peek() != '\n' && !isAtEnd()) {
-        advance();
-      }
+      advanceTo(utils::scan::findNewline(cursor(), end()));
       break;
     default:
       return;
@@ -108,28 +160,29 @@ void Lexer::skipWhitespaceAndComments() {
 
 const Token& Lexer::makeToken(TokenType type) {
   lastToken =
-      Token{type, m_source.slice(m_cursor - 1, 1).str(), {m_line, m_col - 1}};
+      Token{type, m_source.slice(m_cursor - 1, m_cursor), sourceLoc()};
   // For single-character tokens
   return lastToken;
 }
 
 const Token& Lexer::makeToken(TokenType type, StringRef lexeme) {
-  lastToken = Token{type, lexeme.str(), {m_line, m_col - lexeme.size()}};
+  lastToken = Token{type, lexeme, sourceLoc()};
 
   return lastToken;
 }
 
-const Token& Lexer::scanIdentifier() {
-  size_t start = m_cursor - 1;
-  while (isalnum(peek()) || peek() == '_' || peek() == '.') {
-    advance();
+StringRef Lexer::internLowered(StringRef key) {
+  for (const auto& lowered : m_lowered) {
+    if (StringRef(lowered) == key) {
+      return lowered;
+    }
   }
+  return m_lowered.emplace_back(key.str());
+}
 
-  std::string lexeme = m_source.slice(start, m_cursor).str();
-
-  /// lowercase: label, instruction, register, identifier
-  std::transform(lexeme.begin(), lexeme.end(), lexeme.begin(),
-                 [](unsigned char c) { return std::tolower(c); });
+const Token& Lexer::scanIdentifier() {
+  size_t start = m_cursor - 1;
+  advanceTo(utils::scan::skipIdent(cursor(), end()));
 
   // Check if it's a label definition
   if (peek() == ':') {
@@ -138,27 +191,59 @@ const Token& Lexer::scanIdentifier() {
                      m_source.slice(start, m_cursor));
   }
 
-  if (MnemonicContain(lexeme.c_str()) || PseudoContain(lexeme.c_str()) ||
-      lexeme == "li") {
-    return makeToken(TokenType::INSTRUCTION, lexeme);
-  }
+  return makeWord(start);
+}
 
-  /// TODO: more modes to be recognizable
-  if (mc::RoundModes.find(lexeme.c_str())) {
-    return makeToken(TokenType::MODE, lexeme);
+const Token& Lexer::makeWord(std::size_t start) {
+  auto word = m_source.slice(start, m_cursor);
+
+  /// keywords (instruction, mode, register) match on their lowercase
+  /// spelling, only a word written otherwise is lowered, on the stack
+  char buffer[32];
+  auto key = word;
+  auto isUpper = [](char c) { return c >= 'A' && c <= 'Z'; };
+  if (std::any_of(word.begin(), word.end(), isUpper)) {
+    key = StringRef();
+    if (word.size() <= sizeof(buffer)) {
+      std::transform(word.begin(), word.end(), buffer, [&](char c) {
+        return isUpper(c) ? static_cast<char>(c | 0x20) : c;
+      });
+      key = StringRef(buffer, word.size());
+    }
   }
 
-  if (mc::Registers.find(lexeme)) {
-    return makeToken(TokenType::REGISTER, lexeme);
+  auto keyword = key.empty() ? nullptr : findKeyword(key);
+
+  auto makeKeyword = [&](TokenType type) -> const Token& {
+    makeToken(type, key.data() == word.data() ? key : internLowered(key));
+    lastToken.keyword = keyword;
+    return lastToken;
+  };
+
+  if (keyword) {
+    if (keyword->isInstruction()) {
+      return makeKeyword(TokenType::INSTRUCTION);
+    }
+
+    /// TODO: more modes to be recognizable
+    if (keyword->is(Keyword::kMode)) {
+      return makeKeyword(TokenType::MODE);
+    }
+
+    if (keyword->is(Keyword::kRegister)) {
+      return makeKeyword(TokenType::REGISTER);
+    }
   }
 
-  if (lexeme[0] != '.') {
+  if (word[0] != '.') {
     return makeToken(TokenType::IDENTIFIER, m_source.slice(start, m_cursor));
   }
 
   if (lastToken.type == TokenType::NEWLINE || // last
       lastToken.type == TokenType::UNKNOWN) { // very beginning
-    return makeToken(TokenType::DIRECTIVE, m_source.slice(start, m_cursor));
+    makeToken(TokenType::DIRECTIVE, m_source.slice(start, m_cursor));
+    lastToken.keyword = keyword;
+    return lastToken;
   } else {
     return makeToken(TokenType::IDENTIFIER, m_source.slice(start, m_cursor));
   }
@@ -169,24 +254,26 @@ const Token& Lexer::scanNumber() {
   // Check for hexadecimal
   if (m_source[start] == '0' && (peek() == 'x' || peek() == 'X')) {
     advance(); // consume 'x'
-    while (isxdigit(peek())) {
+    while (utils::scan::is(peek(), utils::scan::kHex)) {
       advance();
     }
-    return makeToken(TokenType::HEX_INTEGER, m_source.slice(start, m_cursor));
+    makeToken(TokenType::HEX_INTEGER, m_source.slice(start, m_cursor));
+    decodeNumber();
+    return lastToken;
   }
 
   // Handle negative numbers at the start
   if (m_source[start] == '-') {
-    if (!isdigit(peek())) {
-      return makeToken(TokenType::UNKNOWN, m_source.slice(start, 1));
+    if (!utils::scan::is(peek(), utils::scan::kDigit)) {
+      return makeToken(TokenType::UNKNOWN, m_source.slice(start, start + 1));
     }
   }
 
   // Decimal
   bool dot = false;
-  while (isdigit(peek())) {
+  while (utils::scan::is(peek(), utils::scan::kDigit)) {
 
-    advance();
+    advanceTo(utils::scan::skipDigits(cursor(), end()));
 
     if (utils::is_unlikely(peek() == '.')) {
       dot = true;
@@ -194,22 +281,57 @@ const Token& Lexer::scanNumber() {
     }
   }
 
-  return makeToken(dot ? TokenType::FLOAT : TokenType::INTEGER,
-                   m_source.slice(start, m_cursor));
+  makeToken(dot ? TokenType::FLOAT : TokenType::INTEGER,
+            m_source.slice(start, m_cursor));
+  decodeNumber();
+  return lastToken;
+}
+
+void Lexer::decodeNumber() {
+  auto& token = lastToken;
+  auto begin = token.lexeme.begin();
+  auto end = token.lexeme.end();
+  std::from_chars_result result;
+
+  switch (token.type) {
+  case TokenType::INTEGER: {
+    long long value = 0;
+    result = std::from_chars(begin, end, value);
+    token.value = static_cast<std::uint64_t>(value);
+    break;
+  }
+  case TokenType::HEX_INTEGER:
+    result = std::from_chars(begin + 2, end, token.value, 16);
+    break;
+  case TokenType::FLOAT: {
+    /// .float rounds the literal once, straight to single precision
+    if (auto single = std::from_chars(begin, end, token.single);
+        single.ec != std::errc{} || single.ptr != end) {
+      token.single = std::numeric_limits<float>::quiet_NaN();
+    }
+    double value = 0;
+    result = std::from_chars(begin, end, value);
+    token.value = std::bit_cast<std::uint64_t>(value);
+    break;
+  }
+  default:
+    return;
+  }
+
+  token.invalid = result.ec != std::errc{} || result.ptr != end;
 }
 
 const Token& Lexer::scanString() {
   size_t start = m_cursor; // Start after the opening quote
-  while (peek() != '"' && !isAtEnd()) {
-    if (peek() == '\n') { // Unterminated string
-      m_line++;
-      m_col = 1;
-    }
+  /// a string ends with its line, like any token: streamed and mapped
+  /// input lex it alike
+  while (peek() != '"' && peek() != '\n' && !isAtEnd()) {
     advance();
   }
 
-  if (isAtEnd()) {
-    return makeToken(TokenType::UNKNOWN, "Unterminated string");
+  if (peek() != '"') {
+    /// the quote on, the span a replay rebuilds the lexeme from
+    return makeToken(TokenType::UNKNOWN, m_source.slice(start - 1, m_cursor));
   }
 
   advance(); // Consume the closing quote
@@ -217,39 +339,83 @@ const Token& Lexer::scanString() {
   return makeToken(TokenType::STRING_LITERAL, lexeme);
 }
 
-const Token& Lexer::nextToken() {
+const Token& Lexer::nextToken() { return scan(); }
+
+const Token& Lexer::replay() {
+  auto i = m_token;
+  /// the END_OF_FILE is the last token, it is returned over and over
+  if (m_token + 1 < m_tokens->size()) {
+    ++m_token;
+  }
+
+  auto type = m_tokens->kind(i);
+  auto lexeme = m_tokens->lexeme(i);
+  m_start = m_tokens->offset(i);
+
+  lastToken = Token{type, lexeme, sourceLoc()};
+  lastToken.keyword = m_tokens->keyword(i);
+
+  switch (type) {
+  case TokenType::INTEGER:
+  case TokenType::HEX_INTEGER:
+  case TokenType::FLOAT: {
+    const auto& number = m_tokens->number(i);
+    lastToken.value = number.Value;
+    lastToken.single = number.Single;
+    lastToken.invalid = number.Invalid;
+    break;
+  }
+  default:
+    break;
+  }
+
+  return lastToken;
+}
+
+const Token& Lexer::scan() {
+  if (m_tokens) {
+    return replay();
+  }
+
+  fill();
+
   skipWhitespaceAndComments();
 
+  m_start = m_cursor;
+
   if (isAtEnd()) {
-    lastToken = Token{TokenType::END_OF_FILE, "", {m_line, m_col}};
+    lastToken = Token{TokenType::END_OF_FILE, StringRef(), sourceLoc()};
     return lastToken;
   }
 
+#ifdef RVASM_TABLE_LEXER
+  return scanTable();
+#endif
+
   char c = advance();
 
   if (c == '%') {
     size_t start = m_cursor - 1;
-    while (peek() != '(') {
+    while (peek() != '(' && peek() != '\n' && !isAtEnd()) {
       advance();
     }
-    return makeToken(TokenType::MODIFIERS, m_source.slice(start, m_cursor));
+    makeToken(TokenType::MODIFIERS, m_source.slice(start, m_cursor));
+    lastToken.keyword = findKeyword(lastToken.lexeme);
+    return lastToken;
   }
 
-  if (isalpha(c) || c == '_' || c == '.') {
+  if (utils::scan::is(c, utils::scan::kAlpha) || c == '_' || c == '.') {
     return scanIdentifier();
   }
 
-  if (isdigit(c) || (c == '-' && isdigit(peek()))) {
+  if (utils::scan::is(c, utils::scan::kDigit) ||
+      (c == '-' && utils::scan::is(peek(), utils::scan::kDigit))) {
     return scanNumber();
   }
 
   switch (c) {
-  case '\n': {
-    makeToken(TokenType::NEWLINE);
-    m_line++;
-    m_col = 1;
-    return lastToken;
-  }
+  case '\n':
+    return makeToken(TokenType::NEWLINE);
   case ',':
     return makeToken(TokenType::COMMA);
   case '(':
@@ -265,5 +431,56 @@ const Token& Lexer::nextToken() {
     return makeToken(TokenType::EXPR_OPERATOR);
   }
 
-  return makeToken(TokenType::UNKNOWN, m_source.slice(m_cursor - 1, 1));
-}
\ No newline at end of file
+  return makeToken(TokenType::UNKNOWN, m_source.slice(m_cursor - 1, m_cursor));
+}
+
+std::size_t Lexer::findFunctionEnd(std::size_t From) const {
+  utils_assert(isRandomAccess(), "functions are found in whole sources only");
+
+  auto size = m_source.size();
+  auto at = From;
+
+  while (true) {
+    /// start of the next line
+    auto newline = static_cast<const char*>(
+        std::memchr(m_source.data() + at, '\n', size - at));
+    if (!newline) {
+      return size;
+    }
+
+    auto first = utils::scan::skipBlanks(newline + 1, end());
+    auto begin = static_cast<std::size_t>(first - m_source.data());
+    at = utils::scan::skipIdent(first, end()) - m_source.data();
+
+    auto word = m_source.slice(begin, at);
+    if (word == ".globl" || word == ".global" || word == ".text" ||
+        word == ".data" || word == ".bss") {
+      return begin;
+    }
+  }
+}
+
+void Lexer::skipTo(std::size_t Offset) {
+  if (m_tokens) {
+    auto target = m_tokens->find(Offset);
+    utils_assert(target >= m_token, "skipping backwards");
+    m_token = target;
+  } else {
+    utils_assert(isRandomAccess() && Offset >= m_cursor &&
+                     Offset <= m_source.size(),
+                 "skipping backwards");
+    m_cursor = Offset;
+  }
+
+  /// a directive is only a directive at the start of a line
+  lastToken = Token{TokenType::NEWLINE, "\n", sourceLoc()};
+}
+
+utils::Location Lexer::locate(std::size_t Offset) const {
+  utils_assert(isRandomAccess(), "lines are counted in whole sources only");
+
+  if (!m_lines) {
+    m_lines.emplace(m_source);
+  }
+  return m_lines->locate(Offset);
+}
@@ -0,0 +1,234 @@
+#include "parser/Lexer.hpp"
+#include "utils/logger.hpp"
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+
+using namespace parser;
+
+namespace {
+/// bytes the table tells apart, End past the last one
+enum Class : std::uint8_t {
+  cOther,
+  cNewline,
+  cComma,
+  cLParen,
+  cRParen,
+  cColon,
+  cPlus,
+  cMinus,
+  cQuote,
+  cPercent,
+  cDot,
+  cZero,
+  cDigit,    // 1-9
+  cX,        // x X, ends a "0x"
+  cHexAlpha, // a-f A-F
+  cAlpha,    // the other letters and '_'
+  cEnd,
+  ClassNr,
+};
+
+enum State : std::uint8_t {
+  sStart,
+  sIdent,
+  sMinus,
+  sZero, // a leading 0, "0x" goes on as hex
+  sLead, // a leading 1-9
+  sInt,
+  sDot,  // a '.' after digits
+  sFrac, // digits after a '.'
+  sHex,
+  sModifier,
+  sString,
+  StateNr,
+};
+
+/// what an accepting entry makes of the bytes since the token start
+enum Rule : std::uint8_t {
+  rIdent,
+  rLabel,
+  rInt,
+  rFloat,
+  rHex,
+  rModifier,
+  rString,
+  rUnterminated,
+  rNewline,
+  rComma,
+  rLParen,
+  rRParen,
+  rColon,
+  rOperator,
+  rUnknown,
+};
+
+/// an entry is the next state, or Accept with a Rule: the token ends, the
+/// byte looked at is part of it with Consume
+constexpr std::uint8_t Accept = 0x80;
+constexpr std::uint8_t Consume = 0x40;
+constexpr std::uint8_t RuleMask = 0x3f;
+static_assert(StateNr < Consume);
+
+constexpr std::uint8_t accept(Rule R) { return Accept | R; }
+constexpr std::uint8_t take(Rule R) { return Accept | Consume | R; }
+
+constexpr std::array<std::uint8_t, 256> makeClasses() {
+  std::array<std::uint8_t, 256> Classes{};
+
+  Classes['\n'] = cNewline;
+  Classes[','] = cComma;
+  Classes['('] = cLParen;
+  Classes[')'] = cRParen;
+  Classes[':'] = cColon;
+  Classes['+'] = cPlus;
+  Classes['-'] = cMinus;
+  Classes['"'] = cQuote;
+  Classes['%'] = cPercent;
+  Classes['.'] = cDot;
+  Classes['0'] = cZero;
+  for (unsigned c = '1'; c <= '9'; ++c) {
+    Classes[c] = cDigit;
+  }
+  for (unsigned c = 'a'; c <= 'z'; ++c) {
+    Classes[c] = Classes[c - 'a' + 'A'] = c <= 'f' ? cHexAlpha : cAlpha;
+  }
+  Classes['x'] = Classes['X'] = cX;
+  Classes['_'] = cAlpha;
+
+  return Classes;
+}
+
+using Table = std::array<std::array<std::uint8_t, ClassNr>, StateNr>;
+
+/// the branchy scan() of Lexer.cpp, one row per state
+constexpr Table makeTable() {
+  Table T{};
+
+  auto row = [&](State S, std::uint8_t Otherwise) {
+    for (auto& Next : T[S]) {
+      Next = Otherwise;
+    }
+    return [&T, S](std::initializer_list<Class> Classes, std::uint8_t Next) {
+      for (auto C : Classes) {
+        T[S][C] = Next;
+      }
+    };
+  };
+
+  auto Word = {cDot, cZero, cDigit, cX, cHexAlpha, cAlpha};
+  auto Digits = {cZero, cDigit};
+
+  auto start = row(sStart, take(rUnknown));
+  start({cNewline}, take(rNewline));
+  start({cComma}, take(rComma));
+  start({cLParen}, take(rLParen));
+  start({cRParen}, take(rRParen));
+  start({cColon}, take(rColon));
+  start({cPlus}, take(rOperator));
+  start({cMinus}, sMinus);
+  start({cQuote}, sString);
+  start({cPercent}, sModifier);
+  start({cDot, cX, cHexAlpha, cAlpha}, sIdent);
+  start({cZero}, sZero);
+  start({cDigit}, sLead);
+
+  auto ident = row(sIdent, accept(rIdent));
+  ident(Word, sIdent);
+  ident({cColon}, take(rLabel));
+
+  /// a '-' is a number only right before a digit, never a hex one
+  row(sMinus, accept(rOperator))(Digits, sInt);
+
+  /// a '.' only counts after two digits (scanNumber() looks for more
+  /// digits past the first one), "1.5" is "1" and ".5"
+  auto zero = row(sZero, accept(rInt));
+  zero(Digits, sInt);
+  zero({cX}, sHex);
+  row(sLead, accept(rInt))(Digits, sInt);
+
+  auto integer = row(sInt, accept(rInt));
+  integer(Digits, sInt);
+  integer({cDot}, sDot);
+  row(sDot, accept(rFloat))(Digits, sFrac);
+  auto fraction = row(sFrac, accept(rFloat));
+  fraction(Digits, sFrac);
+  fraction({cDot}, sDot);
+
+  row(sHex, accept(rHex))({cZero, cDigit, cHexAlpha}, sHex);
+
+  /// a modifier runs on to its '(', over blanks but not past its line
+  row(sModifier, sModifier)({cLParen, cNewline, cEnd}, accept(rModifier));
+
+  auto string = row(sString, sString);
+  string({cQuote}, take(rString));
+  string({cNewline, cEnd}, accept(rUnterminated));
+
+  return T;
+}
+
+constexpr auto Classes = makeClasses();
+constexpr Table Transitions = makeTable();
+} // namespace
+
+const Token& Lexer::scanTable() {
+  auto p = cursor();
+  auto last = end();
+
+  std::uint8_t state = sStart;
+  while (!(state & Accept)) {
+    auto c = p < last ? Classes[static_cast<unsigned char>(*p)] : cEnd;
+    state = Transitions[state][c];
+    p += !(state & Accept);
+  }
+  if (state & Consume) {
+    ++p;
+  }
+  advanceTo(p);
+
+  auto lexeme = m_source.slice(m_start, m_cursor);
+
+  switch (static_cast<Rule>(state & RuleMask)) {
+  case rIdent:
+    return makeWord(m_start);
+  case rLabel:
+    return makeToken(TokenType::LABEL_DEFINITION, lexeme);
+  case rInt:
+    makeToken(TokenType::INTEGER, lexeme);
+    decodeNumber();
+    return lastToken;
+  case rFloat:
+    makeToken(TokenType::FLOAT, lexeme);
+    decodeNumber();
+    return lastToken;
+  case rHex:
+    makeToken(TokenType::HEX_INTEGER, lexeme);
+    decodeNumber();
+    return lastToken;
+  case rModifier:
+    makeToken(TokenType::MODIFIERS, lexeme);
+    lastToken.keyword = findKeyword(lexeme);
+    return lastToken;
+  case rString:
+    return makeToken(TokenType::STRING_LITERAL,
+                     m_source.slice(m_start + 1, m_cursor - 1));
+  case rUnterminated:
+    return makeToken(TokenType::UNKNOWN, lexeme);
+  case rNewline:
+    return makeToken(TokenType::NEWLINE);
+  case rComma:
+    return makeToken(TokenType::COMMA);
+  case rLParen:
+    return makeToken(TokenType::LPAREN);
+  case rRParen:
+    return makeToken(TokenType::RPAREN);
+  case rColon:
+    return makeToken(TokenType::COLON);
+  case rOperator:
+    return makeToken(TokenType::EXPR_OPERATOR);
+  case rUnknown:
+    return makeToken(TokenType::UNKNOWN);
+  }
+
+  utils::unreachable("no such lexer rule");
+}
@@ -11,16 +11,42 @@
 #include "utils/logger.hpp"
 #include "utils/macro.hpp"
 #include "utils/misc.hpp"
+#include "utils/source.hpp"
 #include <algorithm>
+#include <bit>
+#include <cmath>
 #include <cstdint>
+#include <format>
 #include <string>
 #include <sys/types.h>
 
 using namespace parser;
 using namespace mc;
 
+namespace {
+/// INTEGER token, decoded by the lexer already
+long long toInteger(const Token& token) {
+  utils_assert(!token.invalid, "invalid integer literal");
+  return static_cast<long long>(token.value);
+}
+
+/// HEX_INTEGER token (0x...), decoded by the lexer already
+unsigned long long toHexInteger(const Token& token) {
+  utils_assert(!token.invalid, "invalid hex integer literal");
+  return token.value;
+}
+} // namespace
+
 void Parser::advance() { token = this->lexer.nextToken(); }
 
+std::string Parser::where() const {
+  if (!lexer.isRandomAccess()) {
+    return std::format("byte {}", lexer.tokenOffset());
+  }
+  auto [line, col] = lexer.locate(lexer.tokenOffset());
+  return std::format("{}:{}", line, col);
+}
+
 uint8_t Parser::RegHelper(const StringRef& reg) {
 
   const unsigned char* find_reg;
@@ -55,7 +81,19 @@ void Parser::parse() {
   advance();
 
   while (token.type != TokenType::END_OF_FILE) {
-    utils_assert(token.type != TokenType::UNKNOWN, "Lexer: error");
+    if (token.type == TokenType::UNKNOWN) {
+      utils::unreachable(std::format("Lexer: error at {}", where()));
+    }
+
+    /// functions only start and end at directives
+    if (Fragments && token.type == TokenType::DIRECTIVE) {
+      if (Recorded && lexer.tokenOffset() >= Recorded->End) {
+        finishFunction();
+      }
+      if (!Recorded && beginFunction()) {
+        continue;
+      }
+    }
 
     switch (token.type) {
     case TokenType::NEWLINE:
@@ -89,9 +127,11 @@ void Parser::parse() {
       ParseModifier();
       break;
     case TokenType::INSTRUCTION:
-      if (token.lexeme == "li") {
+      if (token.keyword->is(Keyword::kLi)) {
         ParseLi();
-      } else if (isPseudo()) {
+      } else if (token.keyword->isAmbiguous()) {
+        ParseAmbiguous();
+      } else if (token.keyword->is(Keyword::kPseudo)) {
         ParsePseudo();
       } else {
         ParseInstruction();
@@ -119,33 +159,89 @@ void Parser::parse() {
 
   if (curInst) { /* when file dosen't end with '\n' */
     ctx.commitTextInst();
+    curInst = nullptr;
+  }
+  if (dataDirective) {
+    endData();
+  }
+
+  if (Recorded) {
+    finishFunction();
+  }
+}
+
+bool Parser::beginFunction() {
+  auto isClean = atTextStatement() && curTextOffset == ctx.getTextOffset();
+  auto isGlobl = token.keyword && token.keyword->is(Directive::kGlobl);
+
+  if (!isClean || !lexer.isRandomAccess() || !isGlobl) {
+    return false;
+  }
+
+  auto begin = lexer.tokenOffset();
+  auto end = lexer.findFunctionEnd(begin);
+  auto align = static_cast<unsigned>(curTextOffset % 4);
+
+  std::string fragment;
+  if (Fragments->lookup(lexer.slice(begin, end), align, fragment) &&
+      ctx.injectFragment(fragment, begin)) {
+    lexer.skipTo(end);
+    curTextOffset = ctx.getTextOffset();
+    advance();
+    return true;
   }
+
+  Recorded = Function{begin, end, align};
+  ctx.beginFragment();
+  return false;
 }
 
-const mc::MCOpCode* Parser::findOpCode(StringRef mnemonic) {
-  auto lookup = OpCacheTab.find(mnemonic);
+void Parser::finishFunction() {
+  auto function = *Recorded;
+  Recorded.reset();
+
+  auto fragment = ctx.endFragment(function.Begin);
+
+  /// a statement ran past the cut or left a directive open, the fragment
+  /// wouldn't replay the same state
+  auto isClean = atTextStatement() && lexer.tokenOffset() == function.End;
 
-  if (lookup != nullptr) {
-    utils_assert(*lookup, "CacheLookUpTab contains invalid key");
-    return *lookup;
+  if (fragment && isClean) {
+    Fragments->insert(lexer.slice(function.Begin, function.End),
+                      function.Align, *fragment);
   }
+}
+
+std::optional<std::string> Parser::parseFunction() {
+  curSection = Section::kText;
+  ctx.beginFragment();
 
-  mc::MCOpCode const* op = MnemonicFind(mnemonic.c_str());
-  OpCacheTab.insert(mnemonic, op);
+  parse();
 
-  return op;
+  auto fragment = ctx.endFragment(0);
+  if (!fragment || !atTextStatement()) {
+    return std::nullopt;
+  }
+  return fragment;
 }
 
 void Parser::ParseNewLine() {
   if (curInst) {
     curTextOffset = ctx.commitTextInst();
     curInst = nullptr;
+  } else if (dataDirective) {
+    endData();
   }
   advance();
 }
 
 void Parser::ParseComma() {
-  utils_assert(curInst, "encounter dangling comma");
+  if (!curInst) {
+    /// .word 1, 2, 3
+    utils_assert(dataDirective && !pendingDirective,
+                 "encounter dangling comma");
+    pendingDirective = dataDirective;
+  }
   advance();
 }
 
@@ -170,248 +266,250 @@ void Parser::ParseIdentifier() {
     /// as dest of jr/br
     JrBrHelper(token.lexeme);
   } else {
+    utils_assert(pendingDirective == Directive::kGlobl,
+                 "expecting a data directive inside a section");
+
     /// check if is marked as global
     using Ndx = MCContext::NdxSection;
-    auto isExist =
-        !StringSwitch<bool>(DirectiveStack.back())
-             .Case(".global", ".globl",
-                   [&](auto&& _) {
-                     const auto& section =
-                         DirectiveStack[DirectiveStack.size() - 2];
-
-                     if (section == ".data") {
-                       return ctx.addReloSym(token.lexeme, curDataOffset,
-                                             Ndx::data);
-                     } else if (section == ".bss") {
-                       return ctx.addReloSym(token.lexeme, curBssOffset,
-                                             Ndx::bss);
-                     } else if (section == ".text") {
-                       return ctx.addReloSym(token.lexeme, curTextOffset,
-                                             Ndx::text);
-                     }
-
-                     utils::unreachable("cant match the section of this label");
-                   })
-             .Error();
-
-    utils_assert(!isExist, "global symbol redefinition");
-
-    DirectiveStack.pop_back(); // .global, .globl
+    bool isNew;
+    switch (curSection) {
+    case Section::kData:
+      isNew = ctx.addReloSym(token.lexeme, curDataOffset, Ndx::data);
+      break;
+    case Section::kBss:
+      isNew = ctx.addReloSym(token.lexeme, curBssOffset, Ndx::bss);
+      break;
+    case Section::kText:
+      isNew = ctx.addReloSym(token.lexeme, curTextOffset, Ndx::text);
+      break;
+    default:
+      utils::unreachable("cant match the section of this label");
+    }
+
+    utils_assert(isNew, "global symbol redefinition");
+
+    pendingDirective.reset(); // .global, .globl
   }
   advance();
 }
 
 void Parser::ParseInteger() {
-  auto dw = std::stoll(token.lexeme);
   if (curInst) {
-    curInst->addOperand(MCOperand::makeImm(dw));
+    curInst->addOperand(MCOperand::makeImm(toInteger(token)));
   } else {
-    /// TODO: more directive
-
-    if (DirectiveStack[DirectiveStack.size() - 2] == ".data") {
-      StringSwitch<bool>(DirectiveStack.back())
-          .Case(".half",
-                [&](auto&& _) {
-                  curDataOffset = ctx.pushDataBuf<uint16_t>(dw);
-                  return true;
-                })
-          .Case(".word",
-                [&](auto&& _) {
-                  curDataOffset = ctx.pushDataBuf<uint32_t>(dw);
-                  return true;
-                })
-          .Case(".dword",
-                [&](auto&& _) {
-                  curDataOffset = ctx.pushDataBuf<uint64_t>(dw);
-                  return true;
-                })
-          .Case(".align",
-                [&](auto&& _) {
-                  utils_assert(dw < 16, "expectling align target to be "
-                                        "small than 16");
-
-                  curDataOffset = ctx.makeDataBufAlign(utils::pow2i(dw));
-
-                  return true;
-                })
-          .Case(".balign",
-                [&](auto&& _) {
-                  auto e = utils::log2(dw);
-                  utils_assert(e, "expecting dw to be pow of 2");
-
-                  curDataOffset = ctx.makeDataBufAlign(dw);
-                  return true;
-                })
-          .Error();
-
-      DirectiveStack.pop_back();
-
-    } else if (DirectiveStack[DirectiveStack.size() - 2] == ".bss") {
-
-      StringSwitch<bool>(DirectiveStack.back())
-          .Case(".zero",
-                [&](auto&& _) {
-                  curBssOffset = ctx.pushBssBuf(dw);
-                  return true;
-                })
-          .Case(".space",
-                [&](auto&& _) {
-                  curBssOffset = ctx.pushBssBuf(dw);
-                  return true;
-                })
-          .Case(".align",
-                [&](auto&& _) {
-                  utils_assert(dw < 16, "expectling align target to be "
-                                        "small than 16");
-
-                  curBssOffset = ctx.makeBssBufAlign(utils::pow2i(dw));
-
-                  return true;
-                })
-          .Case(".balign",
-                [&](auto&& _) {
-                  auto e = utils::log2(dw);
-                  utils_assert(e, "expecting dw to be pow of 2");
-
-                  curBssOffset = ctx.makeBssBufAlign(dw);
-                  return true;
-                })
-          .Error();
-
-      DirectiveStack.pop_back();
-
-    } else {
-      utils::unreachable("expect literal in .data or .bss section");
-    }
+    ParseData();
   }
   advance();
 }
 
 void Parser::ParseHexInteger() {
-  auto dw = std::stoull(token.lexeme, nullptr, 16);
   if (curInst) {
-    curInst->addOperand(MCOperand::makeImm(dw));
+    curInst->addOperand(MCOperand::makeImm(toHexInteger(token)));
   } else {
-    /// TODO: more directive
-
-    if (DirectiveStack[DirectiveStack.size() - 2] == ".data") {
-      StringSwitch<bool>(DirectiveStack.back())
-          .Case(".half",
-                [&](auto&& _) {
-                  curDataOffset = ctx.pushDataBuf<uint16_t>(dw);
-                  return true;
-                })
-          .Case(".word",
-                [&](auto&& _) {
-                  curDataOffset = ctx.pushDataBuf<uint32_t>(dw);
-                  return true;
-                })
-          .Case(".dword",
-                [&](auto&& _) {
-                  curDataOffset = ctx.pushDataBuf<uint64_t>(dw);
-                  return true;
-                })
-          .Case(".align",
-                [&](auto&& _) {
-                  utils_assert(dw < 16, "expectling align target to be "
-                                        "small than 16");
-
-                  curDataOffset = ctx.makeDataBufAlign(utils::pow2i(dw));
-
-                  return true;
-                })
-          .Case(".balign",
-                [&](auto&& _) {
-                  auto e = utils::log2(dw);
-                  utils_assert(e, "expecting dw to be pow of 2");
-
-                  curDataOffset = ctx.makeDataBufAlign(dw);
-                  return true;
-                })
-          .Error();
-
-      DirectiveStack.pop_back();
-
-    } else if (DirectiveStack[DirectiveStack.size() - 2] == ".bss") {
-      utils_assert(dw == 0, "data def in bss supposed to be all zero");
-
-      StringSwitch<bool>(DirectiveStack.back())
-          .Case(".zero",
-                [&](auto&& _) {
-                  curBssOffset = ctx.pushBssBuf(dw);
-                  return true;
-                })
-          .Case(".align",
-                [&](auto&& _) {
-                  utils_assert(dw < 16, "expectling align target to be "
-                                        "small than 16");
-
-                  curBssOffset = ctx.makeBssBufAlign(utils::pow2i(dw));
-
-                  return true;
-                })
-          .Case(".balign",
-                [&](auto&& _) {
-                  auto e = utils::log2(dw);
-                  utils_assert(e, "expecting dw to be pow of 2");
-
-                  curBssOffset = ctx.makeBssBufAlign(dw);
-                  return true;
-                })
-          .Error();
-
-      DirectiveStack.pop_back();
-
-    } else {
-      utils::unreachable("expect literal in .data or .bss section");
-    }
+    ParseData();
   }
   advance();
 }
 
 void Parser::ParseFloat() {
+  utils_assert(!curInst, "unexpected float point operand");
+  utils_assert(!token.invalid, "invalid float point literal");
+  ParseData();
+  advance();
+}
 
-  utils_assert(!DirectiveStack.empty(), "expecting in an directive");
-  auto [fimm, isDouble] =
-      StringSwitch<std::tuple<uint64_t, bool>>(DirectiveStack.back())
-          .Case(".float",
-                [](auto&& Str) -> std::tuple<uint64_t, bool> {
-                  float value;
-                  auto [ptr, ec] = std::from_chars(
-                      Str.data(), Str.data() + Str.size(), value);
-
-                  utils_assert(ec == std::error_code{},
-                               "parse float point failed");
-
-                  return std::make_tuple(*reinterpret_cast<uint64_t*>(&value),
-                                         false);
-                })
-          .Case(".double",
-                [](auto&& Str) -> std::tuple<uint64_t, bool> {
-                  double value;
-                  auto [ptr, ec] = std::from_chars(
-                      Str.data(), Str.data() + Str.size(), value);
-
-                  utils_assert(ec == std::error_code{},
-                               "parse float point failed");
-
-                  return std::make_tuple(*reinterpret_cast<uint64_t*>(&value),
-                                         false);
-                })
-          .Default();
-
-  if (isDouble) {
-    ctx.pushDataBuf(fimm);
-  } else {
-    ctx.pushDataBuf(static_cast<uint32_t>(fimm));
+void Parser::ParseData() {
+  utils_assert(pendingDirective,
+               "expecting a data directive inside a section");
+
+  auto handler = DataHandlers[static_cast<std::size_t>(curSection)]
+                             [static_cast<std::size_t>(*pendingDirective)];
+  utils_assert(handler, "expect literal in .data or .bss section");
+
+  (this->*handler)();
+  dataDirective = pendingDirective;
+  pendingDirective.reset();
+}
+
+void Parser::endData() {
+  auto arg = [&](std::size_t i, std::uint64_t Default) {
+    return i < dataArgs.size() ? dataArgs[i] : Default;
+  };
+
+  if (curSection == Section::kData) {
+    switch (*dataDirective) {
+    case Directive::kZero:
+      utils_assert(dataArgs.size() == 1, "expecting the size only");
+      [[fallthrough]];
+    case Directive::kSpace:
+      curDataOffset = ctx.fillDataBuf(dataArgs[0], 1, arg(1, 0) & 0xff);
+      break;
+    case Directive::kFill: {
+      auto size = arg(1, 1);
+      utils_assert(size <= 8, "expecting a fill size up to 8");
+      /// the value is 4 bytes wide, the bytes above are 0 (as in GNU as)
+      curDataOffset =
+          ctx.fillDataBuf(dataArgs[0], size, arg(2, 0) & 0xffffffff);
+      break;
+    }
+    case Directive::kIncbin: {
+      utils_assert(!incbinPath.empty(), "expecting the file to include");
+      if (!IncludeDir.empty() && incbinPath.front() != '/') {
+        incbinPath = IncludeDir.str() + "/" + incbinPath;
+      }
+      /// mapped and copied over in one go
+      auto file = utils::SourceBuffer::tryOpen(incbinPath.c_str());
+      if (!file) {
+        utils::error(std::format("{}: can't open '{}' for .incbin", where(),
+                                 incbinPath));
+      }
+      auto bytes = file->getBuffer();
+      auto skip = arg(0, 0);
+      utils_assert(skip <= bytes.size(), "skipping past the included file");
+      auto count = std::min<std::uint64_t>(arg(1, bytes.size() - skip),
+                                           bytes.size() - skip);
+      curDataOffset = ctx.includeDataBuf(bytes.data() + skip, count);
+      break;
+    }
+    default:
+      break;
+    }
+  } else if (curSection == Section::kBss && !dataArgs.empty()) {
+    /// .zero/.space: one reservation of the size
+    curBssOffset = ctx.pushBssBuf(dataArgs[0]);
   }
 
-  advance();
+  dataDirective.reset();
+  dataArgs.clear();
+  incbinPath.clear();
+}
+
+std::uint64_t Parser::DataInteger() const {
+  if (token.type == TokenType::HEX_INTEGER) {
+    return toHexInteger(token);
+  }
+  utils_assert(token.type == TokenType::INTEGER, "expecting an integer");
+  return toInteger(token);
+}
+
+void Parser::DataHalf() {
+  curDataOffset = ctx.pushDataBuf<uint16_t>(DataInteger());
+}
+
+void Parser::DataWord() {
+  curDataOffset = ctx.pushDataBuf<uint32_t>(DataInteger());
+}
+
+void Parser::DataDword() {
+  curDataOffset = ctx.pushDataBuf<uint64_t>(DataInteger());
+}
+
+void Parser::DataAlign() {
+  auto dw = DataInteger();
+  utils_assert(dw < 16, "expectling align target to be small than 16");
+  curDataOffset = ctx.makeDataBufAlign(utils::pow2i(dw));
+}
+
+void Parser::DataBalign() {
+  auto dw = DataInteger();
+  utils_assert(utils::log2(dw), "expecting dw to be pow of 2");
+  curDataOffset = ctx.makeDataBufAlign(dw);
+}
+
+void Parser::DataFloat() {
+  utils_assert(token.type == TokenType::FLOAT && !token.invalid &&
+                   !std::isnan(token.single),
+               "parse float point failed");
+  curDataOffset = ctx.pushDataBuf(std::bit_cast<uint32_t>(token.single));
+}
+
+void Parser::DataDouble() {
+  utils_assert(token.type == TokenType::FLOAT && !token.invalid,
+               "parse float point failed");
+  curDataOffset = ctx.pushDataBuf(token.value);
 }
 
+void Parser::DataSpace() {
+  utils_assert(dataArgs.size() < 2, "expecting a size and a fill byte");
+  dataArgs.push_back(DataInteger());
+}
+
+void Parser::DataFill() {
+  utils_assert(dataArgs.size() < 3, "expecting a repeat, size and value");
+  dataArgs.push_back(DataInteger());
+}
+
+void Parser::DataIncbin() {
+  if (incbinPath.empty()) {
+    utils_assert(token.type == TokenType::STRING_LITERAL,
+                 "expecting the file to include");
+    incbinPath = token.lexeme.str();
+    return;
+  }
+
+  utils_assert(dataArgs.size() < 2, "expecting a skip and a count");
+  dataArgs.push_back(DataInteger());
+}
+
+void Parser::BssZero() {
+  if (!dataArgs.empty()) {
+    utils::error(std::format("{}: .bss holds no bytes to fill, expecting "
+                             "the size only",
+                             where()));
+  }
+  dataArgs.push_back(DataInteger());
+}
+
+void Parser::BssAlign() {
+  auto dw = DataInteger();
+  utils_assert(dw < 16, "expectling align target to be small than 16");
+  curBssOffset = ctx.makeBssBufAlign(utils::pow2i(dw));
+}
+
+void Parser::BssBalign() {
+  auto dw = DataInteger();
+  utils_assert(utils::log2(dw), "expecting dw to be pow of 2");
+  curBssOffset = ctx.makeBssBufAlign(dw);
+}
+
+const Parser::DataHandlerTable Parser::DataHandlers = [] {
+  DataHandlerTable Handlers{};
+
+  auto set = [&](Section S, Directive D, DataHandler Handler) {
+    Handlers[static_cast<std::size_t>(S)][static_cast<std::size_t>(D)] =
+        Handler;
+  };
+
+  set(Section::kData, Directive::kHalf, &Parser::DataHalf);
+  set(Section::kData, Directive::kWord, &Parser::DataWord);
+  set(Section::kData, Directive::kDword, &Parser::DataDword);
+  set(Section::kData, Directive::kAlign, &Parser::DataAlign);
+  set(Section::kData, Directive::kBalign, &Parser::DataBalign);
+  set(Section::kData, Directive::kFloat, &Parser::DataFloat);
+  set(Section::kData, Directive::kDouble, &Parser::DataDouble);
+  set(Section::kData, Directive::kZero, &Parser::DataSpace);
+  set(Section::kData, Directive::kSpace, &Parser::DataSpace);
+  set(Section::kData, Directive::kFill, &Parser::DataFill);
+  set(Section::kData, Directive::kIncbin, &Parser::DataIncbin);
+
+  set(Section::kBss, Directive::kZero, &Parser::BssZero);
+  set(Section::kBss, Directive::kSpace, &Parser::BssZero);
+  set(Section::kBss, Directive::kAlign, &Parser::BssAlign);
+  set(Section::kBss, Directive::kBalign, &Parser::BssBalign);
+
+  return Handlers;
+}();
+
 void Parser::ParseModifier() {
   utils_assert(curInst, "expect curInst to be valid");
-  auto ty = mc::MCExpr::getExprTy(token.lexeme);
+  addOperand(parseModifier());
+  advance();
+}
+
+Parser::Operand Parser::parseModifier() {
+  auto ty = token.keyword
+                ? static_cast<mc::MCExpr::ExprTy>(token.keyword->Value)
+                : mc::MCExpr::kInvalid;
   utils_assert(ty, "invalid modifier");
   advance();
   utils_assert(token.type == TokenType::LPAREN,
@@ -434,7 +532,7 @@ void Parser::ParseModifier() {
 
     utils_assert(token.type == TokenType::INTEGER, "expecting integer append");
 
-    op *= std::stoll(token.lexeme); // no hex
+    op *= toInteger(token); // no hex
 
     Append = *reinterpret_cast<uint64_t*>(&op);
 
@@ -444,24 +542,99 @@ void Parser::ParseModifier() {
   utils_assert(token.type == TokenType::RPAREN,
                "expecting right paren after a modifier");
 
-  curInst->addOperand(MCOperand::makeExpr(ctx.getTextExpr(Symbol, ty, Append)));
+  return Operand{.shape = Operand::kExpr,
+                 .Modifier = ty,
+                 .Append = Append,
+                 .Symbol = Symbol.str()};
+}
 
-  ctx.addReloInst(&(*curInst), Symbol);
+Parser::Operands Parser::collectOperands() {
+  Operands ops;
 
-  advance();
+  while (true) {
+    advance();
+    if (token.type == TokenType::NEWLINE ||
+        token.type == TokenType::END_OF_FILE) {
+      return ops;
+    }
+
+    switch (token.type) {
+    case TokenType::COMMA:
+      break;
+    case TokenType::REGISTER:
+      ops.push_back(
+          Operand{.shape = Operand::kReg, .Reg = RegHelper(token.lexeme)});
+      break;
+    case TokenType::INTEGER:
+      ops.push_back(Operand{.shape = Operand::kImm, .Imm = toInteger(token)});
+      break;
+    case TokenType::HEX_INTEGER:
+      ops.push_back(Operand{.shape = Operand::kImm,
+                            .Imm = static_cast<int64_t>(toHexInteger(token))});
+      break;
+    case TokenType::MODE:
+      ops.push_back(
+          Operand{.shape = Operand::kImm, .Imm = token.keyword->Value});
+      break;
+    case TokenType::IDENTIFIER:
+      ops.push_back(
+          Operand{.shape = Operand::kSymbol, .Symbol = token.lexeme.str()});
+      break;
+    case TokenType::MODIFIERS:
+      ops.push_back(parseModifier());
+      break;
+    case TokenType::LPAREN:
+      advance();
+      utils_assert(token.type == TokenType::REGISTER,
+                   "parse as an expr failed");
+      ops.push_back(Operand{.shape = Operand::kReg,
+                            .InParens = true,
+                            .Reg = RegHelper(token.lexeme)});
+      advance();
+      utils_assert(token.type == TokenType::RPAREN, "expecting right paren");
+      break;
+    default:
+      utils::unreachable("unknown item when collecting operands");
+    }
+  }
+}
+
+void Parser::addOperand(const Operand& Op) {
+  switch (Op.shape) {
+  case Operand::kReg:
+    curInst->addOperand(MCOperand::makeReg(Op.Reg));
+    break;
+  case Operand::kImm:
+    curInst->addOperand(MCOperand::makeImm(Op.Imm));
+    break;
+  case Operand::kSymbol:
+    /// as dest of jr/br
+    JrBrHelper(Op.Symbol);
+    break;
+  case Operand::kExpr:
+    curInst->addOperand(MCOperand::makeExpr(
+        ctx.getTextExpr(Op.Symbol, Op.Modifier, Op.Append)));
+    ctx.addReloInst(curInst, Op.Symbol);
+    break;
+  }
 }
 
 void Parser::ParseInstruction() {
+  beginInstruction(token.keyword->OpCode, token.loc);
+  advance();
+}
+
+void Parser::beginInstruction(const MCOpCode* OpCode, SourceLoc Loc) {
   /// must empty
 
-  curInst = ctx.newTextInst(token.lexeme);
+  curInst = ctx.newTextInst(OpCode);
   curInst->modifyOffset(curTextOffset);
-  curInst->modifyLoc(token.loc);
+  curInst->modifyLoc(Loc);
 
   auto [instAlign, padInst] =
       (*curInst).isCompressed()
-          ? std::make_tuple(2, MCInst::makeNop(token.loc, curTextOffset))
-          : std::make_tuple(4, MCInst::makeNop(token.loc, curTextOffset));
+          ? std::make_tuple(2, MCInst::makeNop(Loc, curTextOffset))
+          : std::make_tuple(4, MCInst::makeNop(Loc, curTextOffset));
 
   /// make align
   if (curTextOffset % instAlign) {
@@ -469,22 +642,54 @@ void Parser::ParseInstruction() {
 
     curTextOffset = curInst->getOffset();
   }
+}
 
-  advance();
+void Parser::ParseAmbiguous() {
+  const auto& keyword = *token.keyword;
+  auto loc = token.loc;
+
+  auto ops = collectOperands();
+
+  if (isPseudoForm(keyword, ops)) {
+    emitPseudo(*keyword.Pseudo, ops);
+    return;
+  }
+
+  /// the operands go in as the operand parsers would have added them, the
+  /// statement's NEWLINE commits the inst
+  beginInstruction(keyword.OpCode, loc);
+  for (const auto& op : ops) {
+    addOperand(op);
+  }
+}
+
+bool Parser::isPseudoForm(const Keyword& K, const Operands& Ops) {
+  /// jal <symbol>, jalr <rs>
+  if (K.Name.begin_with("j")) {
+    return Ops.size() == 1;
+  }
+
+  /// l{b|h|w|d} rd, <symbol> / s{b|h|w|d} rd, <symbol>, rt
+  return Ops.size() >= 2 && Ops[1].shape == Operand::kSymbol;
 }
 
 void Parser::ParsePseudo() {
+  const auto& pseudo = *token.keyword->Pseudo;
+  emitPseudo(pseudo, collectOperands());
+}
+
+void Parser::emitPseudo(const Pseudo& pseudo, const Operands& Ops) {
   /// collecting arguments
 
-  auto& pseudo = *PseudoFind(token.lexeme.c_str());
   bool rd = pseudo.rd, rs = pseudo.rs, rt = pseudo.rt;
 
   auto args = pseudo.getArgTuple();
 
-  while ((advance(), token.type != TokenType::NEWLINE)) {
-    switch (token.type) {
-    case TokenType::REGISTER: {
-      auto reg = RegHelper(token.lexeme);
+  for (const auto& op : Ops) {
+    switch (op.shape) {
+    case Operand::kReg: {
+      utils_assert(!op.InParens, "unknown item when unpacking pseudo");
+      auto reg = op.Reg;
       if (rd)
         std::get<0>(args) = reg, rd = false;
       else if (rs)
@@ -492,20 +697,15 @@ void Parser::ParsePseudo() {
       else if (rt)
         std::get<3>(args) = reg, rt = false;
     } break;
-    case TokenType::IDENTIFIER: // assign once
-      std::get<1>(args) = token.lexeme;
-      std::get<4>(args) = token.lexeme;
+    case Operand::kSymbol: // assign once
+      std::get<1>(args) = op.Symbol;
+      std::get<4>(args) = op.Symbol;
       break;
-    case TokenType::COMMA:
-      continue;
-    case TokenType::END_OF_FILE:
-      goto __call_back;
     default:
       utils::unreachable("unknown item when unpacking pseudo");
     }
   }
 
-__call_back:
   /// make align
   auto [instAlign, padInst] =
       std::make_tuple(4, MCInst::makeNop(token.loc, curTextOffset));
@@ -529,7 +729,7 @@ void Parser::ParseLi() {
     curTextOffset = ctx.addTextInst(std::move(padInst));
   }
 
-  std::string reg;
+  StringRef reg;
   int64_t imme;
   while ((advance(), token.type != TokenType::NEWLINE)) {
     switch (token.type) {
@@ -537,10 +737,10 @@ void Parser::ParseLi() {
       reg = token.lexeme;
       break;
     case TokenType::INTEGER:
-      imme = std::stoll(token.lexeme);
+      imme = toInteger(token);
       break;
     case TokenType::HEX_INTEGER:
-      imme = std::stoll(token.lexeme, nullptr, 16);
+      imme = static_cast<int64_t>(toHexInteger(token));
       break;
     case TokenType::COMMA:
       continue;
@@ -553,7 +753,7 @@ void Parser::ParseLi() {
 
 __make_li:
   MCInst::MCInsts insts =
-      MCInst::makeLi(token.loc, curTextOffset, reg.c_str(), imme);
+      MCInst::makeLi(token.loc, curTextOffset, reg, imme);
 
   std::for_each(insts.begin(), insts.end(), [&](auto&& inst) {
     curTextOffset = ctx.addTextInst(std::move(inst));
@@ -569,52 +769,61 @@ void Parser::ParseRegister() {
 /// TODO: recognize more modes
 void Parser::ParseMode() {
   utils_assert(curInst, "expect curInst to be valid");
-  curInst->addOperand(
-      MCOperand::makeImm(*mc::RoundModes.find(token.lexeme.c_str())));
+  curInst->addOperand(MCOperand::makeImm(token.keyword->Value));
 
   advance();
 }
 
 void Parser::ParseDirective() {
-  auto isSectionDirective = StringSwitch<bool>(token.lexeme)
-                                .Case(".data", ".bss", ".text", true)
-                                .Default(false);
-
-  if (isSectionDirective && !DirectiveStack.empty()) {
-    /// end of the last section & start of the new section
-    DirectiveStack.pop_back();
+  utils_assert(token.keyword && token.keyword->is(Keyword::kDirective),
+               "unknown directive");
+
+  switch (auto directive = static_cast<Directive>(token.keyword->Value)) {
+  /// end of the last section & start of the new section
+  case Directive::kText:
+    curSection = Section::kText;
+    pendingDirective.reset();
+    break;
+  case Directive::kData:
+    curSection = Section::kData;
+    pendingDirective.reset();
+    break;
+  case Directive::kBss:
+    curSection = Section::kBss;
+    pendingDirective.reset();
+    break;
+  default:
+    utils_assert(!pendingDirective, "expecting the operand of a directive");
+    pendingDirective = directive;
   }
 
-  DirectiveStack.emplace_back(token.lexeme);
-
   advance();
 }
 
 void Parser::ParseLabelDef() {
-
-  auto _ = StringSwitch<bool>(DirectiveStack.back())
-               .Case(".text",
-                     [&](auto&& _) {
-                       utils_assert(ctx.addTextLabel(token.lexeme.substr(
-                                        0, token.lexeme.length() - 1)),
-                                    "text label redefinition!");
-                       return true;
-                     })
-               .Case(".data",
-                     [&](auto&& _) {
-                       utils_assert(ctx.addDataVar(token.lexeme),
-                                    "data label redefinition!");
-                       return true;
-                     })
-               .Case(".bss",
-                     [&](auto&& _) {
-                       utils_assert(ctx.addBssVar(token.lexeme),
-                                    "bss label redefinition");
-                       return true;
-                     })
-               .Error();
+  utils_assert(!pendingDirective, "expecting the operand of a directive");
+
+  switch (curSection) {
+  case Section::kText:
+    utils_assert(
+        ctx.addTextLabel(token.lexeme.slice(0, token.lexeme.size() - 1)),
+        "text label redefinition!");
+    break;
+  case Section::kData:
+    utils_assert(ctx.addDataVar(token.lexeme), "data label redefinition!");
+    break;
+  case Section::kBss:
+    utils_assert(ctx.addBssVar(token.lexeme), "bss label redefinition");
+    break;
+  default:
+    utils::unreachable("label outside of any section");
+  }
 
   advance();
 }
 
-void Parser::ParseString() { utils::todo("sting def pesudo not impl yet"); }
+void Parser::ParseString() {
+  utils_assert(!curInst, "unexpected string operand");
+  ParseData();
+  advance();
+}
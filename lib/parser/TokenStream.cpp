@@ -0,0 +1,187 @@
+#include "parser/TokenStream.hpp"
+#include "utils/macro.hpp"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+using namespace parser;
+
+namespace {
+/// below this a piece is lexed faster than a worker picks it up
+constexpr std::size_t MinPieceSize = 256 * 1024;
+
+bool isNumber(TokenType Kind) {
+  return Kind == TokenType::INTEGER || Kind == TokenType::HEX_INTEGER ||
+         Kind == TokenType::FLOAT;
+}
+} // namespace
+
+TokenStream::TokenStream(StringRef _Source, utils::ThreadPool* Pool)
+    : Source(_Source) {
+  utils_assert(fits(Source), "source too large to pre-tokenize");
+
+  auto size = Source.size();
+  auto pieceNr = Pool ? std::min(Pool->size() * 4, size / MinPieceSize) : 0;
+
+  /// the cuts, each right past a '\n'
+  std::vector<std::size_t> bounds{0};
+  for (std::size_t k = 1; k < pieceNr; ++k) {
+    auto at = std::max(bounds.back(), k * size / pieceNr);
+    auto newline =
+        static_cast<const char*>(std::memchr(Source.data() + at, '\n',
+                                             size - at));
+    if (!newline || newline + 1 == Source.end()) {
+      break;
+    }
+    bounds.push_back(newline + 1 - Source.data());
+  }
+  bounds.push_back(size);
+
+  if (bounds.size() == 2) {
+    lex(0, size);
+  } else {
+    lexPieces(bounds, *Pool);
+  }
+
+  push(TokenType::END_OF_FILE, size, 0, nullptr);
+
+  /// the guess lex() reserves by is generous, keep it at 8 bytes a token
+  Kinds.shrink_to_fit();
+  Offsets.shrink_to_fit();
+  Lengths.shrink_to_fit();
+  Keywords.shrink_to_fit();
+  Numbers.shrink_to_fit();
+}
+
+void TokenStream::lexPieces(const std::vector<std::size_t>& Bounds,
+                            utils::ThreadPool& Pool) {
+  auto pieceNr = Bounds.size() - 1;
+  std::unique_ptr<TokenStream[]> pieces(new TokenStream[pieceNr]);
+
+  {
+    utils::ThreadPool::TaskGroup Group(Pool);
+    for (std::size_t i = 0; i < pieceNr; ++i) {
+      Group.async([&, i] {
+        pieces[i].Source = Source;
+        pieces[i].lex(Bounds[i], Bounds[i + 1]);
+      });
+    }
+    Group.wait();
+  }
+
+  std::size_t total = 1;
+  for (std::size_t i = 0; i < pieceNr; ++i) {
+    total += pieces[i].size();
+  }
+  Kinds.reserve(total);
+  Offsets.reserve(total);
+  Lengths.reserve(total);
+  Keywords.reserve(total);
+
+  /// no token crosses a line, each piece picks up where the last ended
+  for (std::size_t i = 0; i < pieceNr; ++i) {
+    append(pieces[i]);
+  }
+}
+
+void TokenStream::push(TokenType Kind, std::size_t Offset,
+                       std::size_t Length, const Keyword* K) {
+  auto index = static_cast<std::uint32_t>(Kinds.size());
+
+  Kinds.push_back(Kind);
+  Offsets.push_back(static_cast<std::uint32_t>(Offset));
+  Keywords.push_back(K ? keywordIndex(K) + 1 : 0);
+
+  if (Length < LongLength) {
+    Lengths.push_back(static_cast<std::uint8_t>(Length));
+  } else {
+    Lengths.push_back(LongLength);
+    Long.emplace_back(index, static_cast<std::uint32_t>(Length));
+  }
+}
+
+void TokenStream::lex(std::size_t Begin, std::size_t End) {
+  /// roughly a token every five bytes of assembly
+  auto expected = Kinds.size() + (End - Begin) / 5 + 1;
+  Kinds.reserve(expected);
+  Offsets.reserve(expected);
+  Lengths.reserve(expected);
+  Keywords.reserve(expected);
+
+  auto lexer = Lexer(Source.slice(Begin, End));
+
+  while (true) {
+    const auto& token = lexer.nextToken();
+    if (token.type == TokenType::END_OF_FILE) {
+      break;
+    }
+    push(token.type, Begin + lexer.tokenOffset(), token.lexeme.size(),
+         token.keyword);
+
+    if (isNumber(token.type)) {
+      Numbers.emplace_back(static_cast<std::uint32_t>(Kinds.size() - 1),
+                           Number{token.value, token.single, token.invalid});
+    }
+  }
+}
+
+void TokenStream::append(const TokenStream& Piece) {
+  auto base = static_cast<std::uint32_t>(Kinds.size());
+
+  Kinds.insert(Kinds.end(), Piece.Kinds.begin(), Piece.Kinds.end());
+  Offsets.insert(Offsets.end(), Piece.Offsets.begin(), Piece.Offsets.end());
+  Lengths.insert(Lengths.end(), Piece.Lengths.begin(), Piece.Lengths.end());
+  Keywords.insert(Keywords.end(), Piece.Keywords.begin(),
+                  Piece.Keywords.end());
+  for (auto [index, length] : Piece.Long) {
+    Long.emplace_back(base + index, length);
+  }
+  for (const auto& [index, number] : Piece.Numbers) {
+    Numbers.emplace_back(base + index, number);
+  }
+}
+
+StringRef TokenStream::lexeme(std::size_t i) const {
+  switch (Kinds[i]) {
+  case TokenType::INSTRUCTION:
+  case TokenType::REGISTER:
+  case TokenType::MODE:
+    return keyword(i)->Name;
+  default:
+    break;
+  }
+
+  std::size_t size = Lengths[i];
+  if (size == LongLength) {
+    size = std::lower_bound(Long.begin(), Long.end(),
+                            std::make_pair(static_cast<std::uint32_t>(i), 0u))
+               ->second;
+  }
+
+  /// past the opening quote
+  auto begin = Offsets[i] + (Kinds[i] == TokenType::STRING_LITERAL);
+  return Source.slice(begin, begin + size);
+}
+
+const TokenStream::Number& TokenStream::number(std::size_t i) const {
+  utils_assert(isNumber(Kinds[i]), "only numeric literals are decoded");
+  return std::lower_bound(Numbers.begin(), Numbers.end(), i,
+                          [](const auto& Entry, std::size_t Index) {
+                            return Entry.first < Index;
+                          })
+      ->second;
+}
+
+std::size_t TokenStream::find(std::size_t Offset) const {
+  return std::lower_bound(Offsets.begin(), Offsets.end(), Offset) -
+         Offsets.begin();
+}
+
+std::size_t TokenStream::bytes() const {
+  return Kinds.capacity() * sizeof(TokenType) +
+         Offsets.capacity() * sizeof(std::uint32_t) +
+         Lengths.capacity() * sizeof(std::uint8_t) +
+         Keywords.capacity() * sizeof(std::uint16_t) +
+         Long.capacity() * sizeof(Long.front()) +
+         Numbers.capacity() * sizeof(Numbers.front());
+}
@@ -0,0 +1,30 @@
+#include "rvasm/Assembler.hpp"
+#include "driver/Driver.hpp"
+#include "parser/Lexer.hpp"
+#include "parser/TokenStream.hpp"
+#include "utils/logger.hpp"
+#include <exception>
+#include <optional>
+
+using namespace rvasm;
+
+ObjectBuffer rvasm::assemble(StringRef Source, const Options& Opts) {
+  /// every utils_assert/unreachable below throws instead of aborting
+  utils::recoverable_scope scope;
+
+  try {
+    std::optional<parser::TokenStream> Tokens;
+    if (Opts.PreTokenize && parser::TokenStream::fits(Source)) {
+      Tokens.emplace(Source, Opts.Pool);
+    }
+
+    auto Lexer = Tokens ? parser::Lexer(*Tokens) : parser::Lexer(Source);
+    return ObjectBuffer(
+        driver::assemble(Lexer, utils::OutputBuffer::inMemory, Opts.Pool));
+  } catch (const utils::fatal_error& e) {
+    return ObjectBuffer(std::string(e.what()));
+  } catch (const std::exception& e) {
+    /// e.g. std::bad_alloc on a huge source
+    return ObjectBuffer(std::string(e.what()));
+  }
+}
@@ -1,7 +1,32 @@
 #include "utils/ADT/ByteStream.hpp"
+#include <algorithm>
+#include <cstring>
 
 using namespace utils::ADT;
 
+void ByteStream::repeat(const void* Pattern, size_ty N, size_ty Count) {
+  auto total = N * Count;
+  auto at = buffer.size();
+
+  grow(total);
+  buffer.resize(at + total);
+
+  auto pattern = static_cast<const uint8_t*>(Pattern);
+  if (!total || std::all_of(pattern, pattern + N,
+                            [](uint8_t Byte) { return Byte == 0; })) {
+    return;
+  }
+
+  /// the copies made so far are the source of twice as many
+  auto out = buffer.data() + at;
+  std::memcpy(out, pattern, N);
+  for (size_ty done = N; done < total;) {
+    auto n = std::min(done, total - done);
+    std::memcpy(out + done, out, n);
+    done += n;
+  }
+}
+
 ByteStream::size_ty ByteStream::findOffset(StringRef Str) const {
   size_ty offset = 0;
   for (const auto& chr : buffer) {
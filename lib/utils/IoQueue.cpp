@@ -0,0 +1,603 @@
+#include "utils/IoQueue.hpp"
+#include "utils/logger.hpp"
+#include "utils/macro.hpp"
+#include "utils/output.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+
+using namespace utils;
+
+struct IoQueue::Request {
+  bool IsWrite = false;
+  std::string Path;
+
+  /// where a write goes until it is renamed over Path, empty when written
+  /// in place (pipes, /dev/null...)
+  std::string Staged;
+
+  std::string In;
+  std::vector<char> Out;
+
+  int Fd = -1;
+  size_ty Size = 0;
+  size_ty Done = 0;
+
+  /// what went wrong, none once finished fine
+  const char* Failure = nullptr;
+  bool Finished = false;
+
+  char* buffer() { return IsWrite ? Out.data() : In.data(); }
+};
+
+namespace {
+/// a single read/write moves at most 1 GiB (the kernel stops short of
+/// 2 GiB anyway), larger files take several
+constexpr std::size_t MaxTransfer = std::size_t(1) << 30;
+
+/// user_data of the eventfd poll, requests are tagged with their address
+constexpr std::uint64_t WakeupTag = 0;
+
+std::uint64_t nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/// pipes, ttys, /dev/null...: no offsets, moved with plain read()/write()
+const char* transferBlocking(int Fd, std::string& In) {
+  constexpr std::size_t ChunkSize = 64 * 1024;
+
+  while (true) {
+    auto filled = In.size();
+    In.resize(filled + ChunkSize);
+
+    auto n = ::read(Fd, In.data() + filled, ChunkSize);
+    In.resize(filled + std::max<ssize_t>(n, 0));
+
+    if (n == 0) {
+      return nullptr;
+    } else if (n < 0 && errno != EINTR) {
+      return "Failed to read file";
+    }
+  }
+}
+
+const char* transferBlocking(int Fd, const std::vector<char>& Out) {
+  for (std::size_t written = 0; written < Out.size();) {
+    auto n = ::write(Fd, Out.data() + written, Out.size() - written);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n <= 0) {
+      return "Failed to write file";
+    }
+
+    written += n;
+  }
+
+  return nullptr;
+}
+} // namespace
+
+/// the raw io_uring interface, no liburing: a submission and a completion
+/// ring shared with the kernel, only ever touched by the I/O thread
+class IoQueue::Ring {
+  int Fd = -1;
+
+  void* SqMap = MAP_FAILED;
+  size_ty SqMapSize = 0;
+  void* CqMap = MAP_FAILED;
+  size_ty CqMapSize = 0;
+  void* SqeMap = MAP_FAILED;
+  size_ty SqeMapSize = 0;
+
+  unsigned* SqHead = nullptr;
+  unsigned* SqTail = nullptr;
+  unsigned* SqMask = nullptr;
+  unsigned* SqArray = nullptr;
+  io_uring_sqe* Sqes = nullptr;
+  unsigned SqEntries = 0;
+
+  unsigned* CqHead = nullptr;
+  unsigned* CqTail = nullptr;
+  unsigned* CqMask = nullptr;
+  io_uring_cqe* Cqes = nullptr;
+
+  /// sqes handed out by next(), published to the kernel by enter()
+  unsigned LocalTail = 0;
+  unsigned Unsubmitted = 0;
+
+  Ring() = default;
+
+public:
+  Ring(const Ring&) = delete;
+  Ring& operator=(const Ring&) = delete;
+
+  ~Ring() {
+    if (SqeMap != MAP_FAILED) {
+      ::munmap(SqeMap, SqeMapSize);
+    }
+    if (CqMap != MAP_FAILED && CqMap != SqMap) {
+      ::munmap(CqMap, CqMapSize);
+    }
+    if (SqMap != MAP_FAILED) {
+      ::munmap(SqMap, SqMapSize);
+    }
+    if (Fd >= 0) {
+      ::close(Fd);
+    }
+  }
+
+  /// none when the kernel has no io_uring for us (too old, seccomp...)
+  static std::unique_ptr<Ring> create(unsigned Entries) {
+    io_uring_params params{};
+
+    auto ring = std::unique_ptr<Ring>(new Ring);
+    ring->Fd = static_cast<int>(::syscall(__NR_io_uring_setup, Entries, &params));
+    if (ring->Fd < 0) {
+      return nullptr;
+    }
+
+    ring->SqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->CqMapSize =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    ring->SqeMapSize = params.sq_entries * sizeof(io_uring_sqe);
+
+    auto map = [&](size_ty Size, off_t Offset) {
+      return ::mmap(nullptr, Size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring->Fd, Offset);
+    };
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      ring->SqMapSize = ring->CqMapSize =
+          std::max(ring->SqMapSize, ring->CqMapSize);
+      ring->SqMap = ring->CqMap = map(ring->SqMapSize, IORING_OFF_SQ_RING);
+    } else {
+      ring->SqMap = map(ring->SqMapSize, IORING_OFF_SQ_RING);
+      ring->CqMap = map(ring->CqMapSize, IORING_OFF_CQ_RING);
+    }
+    ring->SqeMap = map(ring->SqeMapSize, IORING_OFF_SQES);
+
+    if (ring->SqMap == MAP_FAILED || ring->CqMap == MAP_FAILED ||
+        ring->SqeMap == MAP_FAILED) {
+      return nullptr;
+    }
+
+    auto sq = static_cast<char*>(ring->SqMap);
+    ring->SqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    ring->SqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    ring->SqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    ring->SqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    ring->Sqes = static_cast<io_uring_sqe*>(ring->SqeMap);
+    ring->SqEntries = params.sq_entries;
+    ring->LocalTail = *ring->SqTail;
+
+    auto cq = static_cast<char*>(ring->CqMap);
+    ring->CqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    ring->CqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    ring->CqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    ring->Cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    return ring;
+  }
+
+  /// a zeroed sqe, none when the submission ring is full
+  io_uring_sqe* next() {
+    auto head = std::atomic_ref(*SqHead).load(std::memory_order_acquire);
+    if (LocalTail - head >= SqEntries) {
+      return nullptr;
+    }
+
+    auto index = LocalTail++ & *SqMask;
+    SqArray[index] = index;
+    ++Unsubmitted;
+
+    auto* sqe = &Sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+  }
+
+  /// submit what next() handed out, wait for at least one completion
+  bool enter() {
+    std::atomic_ref(*SqTail).store(LocalTail, std::memory_order_release);
+
+    while (true) {
+      auto n = ::syscall(__NR_io_uring_enter, Fd, Unsubmitted, 1,
+                         IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (n >= 0) {
+        Unsubmitted -= n;
+        return true;
+      } else if (errno == EAGAIN || errno == EBUSY) {
+        /// completions have to be reaped first
+        return true;
+      } else if (errno != EINTR) {
+        return false;
+      }
+    }
+  }
+
+  /// `OnCompletion(user_data, res)` for every completion so far
+  template <typename Fn> void reap(Fn&& OnCompletion) {
+    auto head = *CqHead;
+    auto tail = std::atomic_ref(*CqTail).load(std::memory_order_acquire);
+
+    for (; head != tail; ++head) {
+      const auto& cqe = Cqes[head & *CqMask];
+      OnCompletion(cqe.user_data, cqe.res);
+    }
+
+    std::atomic_ref(*CqHead).store(head, std::memory_order_release);
+  }
+};
+
+IoQueue::IoQueue(unsigned _Depth) : Depth(std::max(_Depth, 1u)) {
+  /// one slot on top for the wakeup poll
+  Uring = Ring::create(Depth + 1);
+
+  if (Uring) {
+    Wakeup = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (Wakeup < 0) {
+      Uring.reset();
+    }
+  }
+
+  Counters.Backend = Uring ? "io_uring" : "pread/pwrite";
+  Worker = std::thread([this] { Uring ? runUring() : runBlocking(); });
+}
+
+IoQueue::~IoQueue() {
+  {
+    std::lock_guard guard(Lock);
+    Stopping = true;
+  }
+
+  Changed.notify_all();
+  if (Wakeup >= 0) {
+    ::eventfd_write(Wakeup, 1);
+  }
+
+  Worker.join();
+
+  if (Wakeup >= 0) {
+    ::close(Wakeup);
+  }
+}
+
+void IoQueue::submit(Handle Req) {
+  {
+    std::lock_guard guard(Lock);
+    Queued.push_back(std::move(Req));
+  }
+
+  /// whichever backend runs listens to one of them
+  Changed.notify_all();
+  if (Wakeup >= 0) {
+    ::eventfd_write(Wakeup, 1);
+  }
+}
+
+IoQueue::Handle IoQueue::read(std::string Path) {
+  auto req = std::make_shared<Request>();
+  req->Path = std::move(Path);
+
+  submit(req);
+  return req;
+}
+
+void IoQueue::write(std::string Path, std::vector<char> Bytes) {
+  auto req = std::make_shared<Request>();
+  req->IsWrite = true;
+  req->Path = std::move(Path);
+  req->Out = std::move(Bytes);
+
+  {
+    std::unique_lock guard(Lock);
+
+    if (PendingWrites >= Depth) {
+      auto begin = nowNs();
+      Changed.wait(guard, [&] { return PendingWrites < Depth; });
+      Counters.WaitNs += nowNs() - begin;
+    }
+    ++PendingWrites;
+  }
+
+  submit(std::move(req));
+}
+
+std::string IoQueue::wait(const Handle& Read) {
+  utils_assert(Read && !Read->IsWrite, "waiting on something never read");
+
+  {
+    std::unique_lock guard(Lock);
+
+    if (!Read->Finished) {
+      auto begin = nowNs();
+      Changed.wait(guard, [&] { return Read->Finished; });
+      Counters.WaitNs += nowNs() - begin;
+    }
+  }
+
+  if (Read->Failure) {
+    utils::error(std::format("{} '{}'", Read->Failure, Read->Path));
+  }
+
+  return std::move(Read->In);
+}
+
+void IoQueue::drain() {
+  std::string failure;
+
+  {
+    std::unique_lock guard(Lock);
+
+    if (PendingWrites) {
+      auto begin = nowNs();
+      Changed.wait(guard, [&] { return PendingWrites == 0; });
+      Counters.WaitNs += nowNs() - begin;
+    }
+
+    failure = std::exchange(WriteFailure, {});
+  }
+
+  if (!failure.empty()) {
+    utils::error(failure);
+  }
+}
+
+IoQueue::Stats IoQueue::stats() const {
+  std::lock_guard guard(Lock);
+  return Counters;
+}
+
+void IoQueue::finish(Request& Req, const char* Failure) {
+  if (Req.Fd >= 0) {
+    ::close(Req.Fd);
+    Req.Fd = -1;
+  }
+
+  /// only a complete object replaces the destination
+  if (!Req.Staged.empty()) {
+    if (!Failure && ::rename(Req.Staged.c_str(), Req.Path.c_str()) != 0) {
+      Failure = "Failed to write file";
+    }
+    if (Failure) {
+      ::unlink(Req.Staged.c_str());
+    }
+    Req.Staged.clear();
+  }
+
+  {
+    std::lock_guard guard(Lock);
+
+    Req.Failure = Failure;
+    Req.Finished = true;
+
+    if (Req.IsWrite) {
+      ++Counters.Writes;
+      --PendingWrites;
+      if (Failure && WriteFailure.empty()) {
+        WriteFailure = std::format("{} '{}'", Failure, Req.Path);
+      }
+
+      /// nobody waits on the bytes of a write
+      Req.Out = {};
+    } else {
+      ++Counters.Reads;
+    }
+
+    Counters.Bytes += Req.Done;
+  }
+
+  Changed.notify_all();
+}
+
+bool IoQueue::start(Request& Req) {
+  const auto* path = Req.Path.c_str();
+
+  if (Req.IsWrite) {
+    /// a fresh inode renamed over `Path` once written, like
+    /// utils::OutputBuffer::create: never written through a hard link (e.g.
+    /// one shared with driver::ObjectCache), and a failed or killed batch
+    /// leaves no truncated object behind
+    struct stat old{};
+    if (::stat(path, &old) == 0 && !S_ISREG(old.st_mode)) {
+      Req.Fd = ::open(path, O_WRONLY | O_CLOEXEC);
+    } else {
+      Req.Staged = stagedPath(path);
+      Req.Fd = ::open(Req.Staged.c_str(),
+                      O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+      if (Req.Fd < 0) {
+        Req.Staged.clear(); // not ours to remove
+      }
+    }
+
+    Req.Size = Req.Out.size();
+  } else {
+    Req.Fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  }
+
+  struct stat st{};
+  if (Req.Fd < 0 || ::fstat(Req.Fd, &st) != 0) {
+    finish(Req, "Failed to open file");
+    return false;
+  }
+
+  if (!S_ISREG(st.st_mode)) {
+    auto failure = Req.IsWrite ? transferBlocking(Req.Fd, Req.Out)
+                               : transferBlocking(Req.Fd, Req.In);
+    Req.Done = Req.IsWrite ? Req.Out.size() : Req.In.size();
+    finish(Req, failure);
+    return false;
+  }
+
+  if (!Req.IsWrite) {
+    Req.Size = st.st_size;
+    Req.In.resize(Req.Size);
+  }
+
+  if (Req.Size == 0) {
+    finish(Req, nullptr);
+    return false;
+  }
+
+  return true;
+}
+
+void IoQueue::runBlocking() {
+  while (true) {
+    Handle req;
+
+    {
+      std::unique_lock guard(Lock);
+      Changed.wait(guard, [&] { return Stopping || !Queued.empty(); });
+
+      if (Queued.empty()) {
+        return;
+      }
+
+      req = std::move(Queued.front());
+      Queued.pop_front();
+    }
+
+    if (!start(*req)) {
+      continue;
+    }
+
+    const char* failure = nullptr;
+
+    while (req->Done < req->Size) {
+      auto size = std::min(req->Size - req->Done, MaxTransfer);
+      auto* buffer = req->buffer() + req->Done;
+
+      auto n = req->IsWrite ? ::pwrite(req->Fd, buffer, size, req->Done)
+                            : ::pread(req->Fd, buffer, size, req->Done);
+
+      if (n < 0 && errno == EINTR) {
+        continue;
+      } else if (n < 0 || (n == 0 && req->IsWrite)) {
+        failure = req->IsWrite ? "Failed to write file" : "Failed to read file";
+        break;
+      } else if (n == 0) {
+        /// the file shrank since fstat
+        req->In.resize(req->Size = req->Done);
+      }
+
+      req->Done += n;
+    }
+
+    finish(*req, failure);
+  }
+}
+
+void IoQueue::runUring() {
+  /// keeps the requests alive while the kernel points into them
+  std::unordered_map<Request*, Handle> inFlight;
+  bool armed = false;
+
+  /// the next piece of `Req`, there is always room: at most Depth requests
+  /// and the poll are in flight
+  auto transfer = [&](Request& Req) {
+    auto* sqe = Uring->next();
+    utils_assert(sqe, "io_uring submission ring overflow");
+
+    sqe->opcode = Req.IsWrite ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = Req.Fd;
+    sqe->addr = reinterpret_cast<std::uint64_t>(Req.buffer() + Req.Done);
+    sqe->len = std::min(Req.Size - Req.Done, MaxTransfer);
+    sqe->off = Req.Done;
+    sqe->user_data = reinterpret_cast<std::uint64_t>(&Req);
+  };
+
+  auto complete = [&](Request& Req, const char* Failure) {
+    finish(Req, Failure);
+    inFlight.erase(&Req);
+  };
+
+  while (true) {
+    {
+      std::unique_lock guard(Lock);
+
+      if (Stopping && Queued.empty() && inFlight.empty()) {
+        return;
+      }
+
+      while (!Queued.empty() && inFlight.size() < Depth) {
+        auto req = std::move(Queued.front());
+        Queued.pop_front();
+
+        guard.unlock();
+        if (start(*req)) {
+          transfer(*req);
+          inFlight.emplace(req.get(), std::move(req));
+        }
+        guard.lock();
+      }
+    }
+
+    /// new requests (or the destructor) ring the eventfd
+    if (!armed) {
+      auto* sqe = Uring->next();
+      utils_assert(sqe, "io_uring submission ring overflow");
+
+      sqe->opcode = IORING_OP_POLL_ADD;
+      sqe->fd = Wakeup;
+      sqe->poll32_events = POLLIN;
+      sqe->user_data = WakeupTag;
+      armed = true;
+    }
+
+    if (!Uring->enter()) {
+      /// the ring broke down, whatever it held is lost
+      while (!inFlight.empty()) {
+        auto& req = *inFlight.begin()->first;
+        complete(req, req.IsWrite ? "Failed to write file"
+                                  : "Failed to read file");
+      }
+      return runBlocking();
+    }
+
+    Uring->reap([&](std::uint64_t Tag, int Res) {
+      if (Tag == WakeupTag) {
+        eventfd_t count;
+        ::eventfd_read(Wakeup, &count);
+        armed = false;
+        return;
+      }
+
+      auto& req = *reinterpret_cast<Request*>(Tag);
+
+      if (Res == -EINTR || Res == -EAGAIN) {
+        transfer(req);
+        return;
+      } else if (Res < 0 || (Res == 0 && req.IsWrite)) {
+        complete(req, req.IsWrite ? "Failed to write file"
+                                  : "Failed to read file");
+        return;
+      } else if (Res == 0) {
+        /// the file shrank since fstat
+        req.In.resize(req.Size = req.Done);
+      }
+
+      req.Done += Res;
+
+      if (req.Done < req.Size) {
+        transfer(req);
+      } else {
+        complete(req, nullptr);
+      }
+    });
+  }
+}
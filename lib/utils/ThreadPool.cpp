@@ -0,0 +1,163 @@
+#include "utils/ThreadPool.hpp"
+#include "utils/logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+using namespace utils;
+
+namespace {
+/// the pool and queue the current thread is working for
+thread_local const ThreadPool* CurrentPool = nullptr;
+thread_local std::size_t CurrentQueue = 0;
+} // namespace
+
+ThreadPool::ThreadPool(unsigned ThreadNr) {
+  if (!ThreadNr) {
+    ThreadNr = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  for (unsigned i = 0; i < ThreadNr; ++i) {
+    Queues.emplace_back(std::make_unique<WorkQueue>());
+  }
+
+  for (unsigned i = 0; i < ThreadNr; ++i) {
+    Workers.emplace_back([this, i] { workerLoop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(SleepLock);
+    Stopping = true;
+  }
+  WakeUp.notify_all();
+
+  for (auto& worker : Workers) {
+    worker.join();
+  }
+}
+
+ThreadPool::size_ty ThreadPool::selfQueue() const {
+  return CurrentPool == this ? CurrentQueue : Queues.size();
+}
+
+void ThreadPool::push(Task T) {
+  /// workers keep their own tasks local, outsiders spread round-robin
+  auto self = selfQueue();
+  auto idx = self < Queues.size() ? self : NextQueue++ % Queues.size();
+
+  {
+    std::lock_guard<std::mutex> lock(Queues[idx]->Lock);
+    Queues[idx]->Tasks.push_back(std::move(T));
+  }
+
+  ++Queued;
+
+  /// pairs with the predicate check in workerLoop, no lost wake-ups
+  { std::lock_guard<std::mutex> lock(SleepLock); }
+  WakeUp.notify_one();
+}
+
+bool ThreadPool::runOne(size_ty Self) {
+  Task task;
+
+  if (Self < Queues.size()) {
+    auto& own = *Queues[Self];
+    std::lock_guard<std::mutex> lock(own.Lock);
+    if (!own.Tasks.empty()) {
+      task = std::move(own.Tasks.back());
+      own.Tasks.pop_back();
+    }
+  }
+
+  for (size_ty i = 1; !task && i <= Queues.size(); ++i) {
+    auto& victim = *Queues[(Self + i) % Queues.size()];
+    std::lock_guard<std::mutex> lock(victim.Lock);
+    if (!victim.Tasks.empty()) {
+      task = std::move(victim.Tasks.front());
+      victim.Tasks.pop_front();
+    }
+  }
+
+  if (!task) {
+    return false;
+  }
+
+  --Queued;
+  task();
+
+  return true;
+}
+
+void ThreadPool::workerLoop(size_ty Self) {
+  CurrentPool = this;
+  CurrentQueue = Self;
+
+  while (true) {
+    if (runOne(Self)) {
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(SleepLock);
+    WakeUp.wait(lock, [this] { return Stopping || Queued > 0; });
+
+    if (Stopping && Queued == 0) {
+      return;
+    }
+  }
+}
+
+void ThreadPool::TaskGroup::async(Task T) {
+  ++Pending;
+
+  Pool.push([this, T = std::move(T), recoverable = logger::is_recoverable()] {
+    std::exception_ptr failure;
+
+    try {
+      if (recoverable) {
+        recoverable_scope scope;
+        T();
+      } else {
+        T();
+      }
+    } catch (...) {
+      failure = std::current_exception();
+    }
+
+    /// the group may be gone as soon as the waiter sees zero, so the last
+    /// touch of it must happen under the lock the waiter leaves through
+    std::lock_guard<std::mutex> lock(Lock);
+    if (failure && !Failure) {
+      Failure = failure;
+    }
+    if (--Pending == 0) {
+      Done.notify_all();
+    }
+  });
+}
+
+void ThreadPool::TaskGroup::wait() {
+  join();
+
+  if (auto failure = std::exchange(Failure, nullptr)) {
+    std::rethrow_exception(failure);
+  }
+}
+
+void ThreadPool::TaskGroup::join() {
+  auto self = Pool.selfQueue();
+
+  while (Pending > 0) {
+    if (Pool.runOne(self)) {
+      continue;
+    }
+
+    /// nothing left to help with, sleep until the stragglers finish
+    std::unique_lock<std::mutex> lock(Lock);
+    Done.wait_for(lock, std::chrono::milliseconds(1),
+                  [this] { return Pending == 0; });
+  }
+
+  std::lock_guard<std::mutex> lock(Lock);
+}
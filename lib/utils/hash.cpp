@@ -0,0 +1,97 @@
+#include "utils/hash.hpp"
+#include <cstddef>
+#include <cstring>
+
+using namespace utils;
+
+namespace {
+constexpr std::uint64_t Prime1 = 11400714785074694791ull;
+constexpr std::uint64_t Prime2 = 14029467366897019727ull;
+constexpr std::uint64_t Prime3 = 1609587929392839161ull;
+constexpr std::uint64_t Prime4 = 9650029242287828579ull;
+constexpr std::uint64_t Prime5 = 2870177450012600261ull;
+
+std::uint64_t rotl(std::uint64_t x, unsigned r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+/// little-endian hosts only (x86-64, riscv64), like the ELF writer
+std::uint64_t read64(const char* p) {
+  std::uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+std::uint32_t read32(const char* p) {
+  std::uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+std::uint64_t round(std::uint64_t acc, std::uint64_t input) {
+  acc += input * Prime2;
+  acc = rotl(acc, 31);
+  return acc * Prime1;
+}
+
+std::uint64_t mergeRound(std::uint64_t acc, std::uint64_t val) {
+  acc ^= round(0, val);
+  return acc * Prime1 + Prime4;
+}
+} // namespace
+
+std::uint64_t utils::xxhash64(ADT::StringRef Data, std::uint64_t Seed) {
+  const char* p = Data.data();
+  const char* end = p + Data.size();
+  std::uint64_t h;
+
+  if (Data.size() >= 32) {
+    std::uint64_t v1 = Seed + Prime1 + Prime2;
+    std::uint64_t v2 = Seed + Prime2;
+    std::uint64_t v3 = Seed;
+    std::uint64_t v4 = Seed - Prime1;
+
+    /// four independent lanes keep the multipliers busy
+    for (; p + 32 <= end; p += 32) {
+      v1 = round(v1, read64(p));
+      v2 = round(v2, read64(p + 8));
+      v3 = round(v3, read64(p + 16));
+      v4 = round(v4, read64(p + 24));
+    }
+
+    h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    h = mergeRound(h, v1);
+    h = mergeRound(h, v2);
+    h = mergeRound(h, v3);
+    h = mergeRound(h, v4);
+  } else {
+    h = Seed + Prime5;
+  }
+
+  h += Data.size();
+
+  for (; p + 8 <= end; p += 8) {
+    h ^= round(0, read64(p));
+    h = rotl(h, 27) * Prime1 + Prime4;
+  }
+
+  if (p + 4 <= end) {
+    h ^= std::uint64_t(read32(p)) * Prime1;
+    h = rotl(h, 23) * Prime2 + Prime3;
+    p += 4;
+  }
+
+  for (; p < end; ++p) {
+    h ^= std::uint64_t(static_cast<unsigned char>(*p)) * Prime5;
+    h = rotl(h, 11) * Prime1;
+  }
+
+  /// avalanche
+  h ^= h >> 33;
+  h *= Prime2;
+  h ^= h >> 29;
+  h *= Prime3;
+  h ^= h >> 32;
+
+  return h;
+}
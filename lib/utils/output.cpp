@@ -0,0 +1,185 @@
+#include "utils/output.hpp"
+#include "utils/logger.hpp"
+#include "utils/macro.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <format>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <utility>
+
+using namespace utils;
+
+std::string utils::stagedPath(const char* Path) {
+  static std::atomic<unsigned> Counter = 0;
+  return std::string(Path) + ".tmp." + std::to_string(::getpid()) + "." +
+         std::to_string(Counter++);
+}
+
+OutputBuffer::OutputBuffer(OutputBuffer&& Other) { *this = std::move(Other); }
+
+OutputBuffer& OutputBuffer::operator=(OutputBuffer&& Other) {
+  if (this == &Other) {
+    return *this;
+  }
+
+  discard();
+
+  MappedSize = std::exchange(Other.MappedSize, 0);
+  Size = std::exchange(Other.Size, 0);
+  Fd = std::exchange(Other.Fd, -1);
+  OwnsFd = std::exchange(Other.OwnsFd, false);
+  Owned = std::move(Other.Owned);
+  Path = std::exchange(Other.Path, {});
+  Staged = std::exchange(Other.Staged, {});
+  Data = isMapped() ? std::exchange(Other.Data, nullptr) : Owned.data();
+  Other.Data = nullptr;
+
+  return *this;
+}
+
+OutputBuffer::~OutputBuffer() { discard(); }
+
+OutputBuffer OutputBuffer::create(const char* Path, size_ty Size) {
+  /// e.g. /dev/null or a fifo, written in place on commit
+  struct stat old{};
+  if (::stat(Path, &old) == 0 && !S_ISREG(old.st_mode)) {
+    int fd = ::open(Path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+      utils::unreachable("Failed to open file");
+    }
+
+    auto Buffer = fromFd(fd, Size);
+    Buffer.OwnsFd = true;
+    return Buffer;
+  }
+
+  /// a fresh inode renamed over `Path` on commit: never written through a
+  /// hard link (e.g. one shared with driver::ObjectCache), and a failed
+  /// run leaves no object of the right size behind for make
+  auto staged = stagedPath(Path);
+  int fd = ::open(staged.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+  if (fd < 0) {
+    utils::unreachable("Failed to open file");
+  }
+
+  OutputBuffer Buffer;
+  Buffer.Path = Path;
+  Buffer.Staged = std::move(staged);
+
+  /// the blocks are reserved up front: a full disk fails here, not as a
+  /// SIGBUS on a store into the mapping; filesystems that can't reserve
+  /// take the write() path, which reports it
+  auto Reserved = false;
+  if (Size > 0) {
+    auto err = ::posix_fallocate(fd, 0, Size);
+    if (err != 0 && err != EOPNOTSUPP && err != EINVAL) {
+      ::close(fd);
+      ::unlink(Buffer.Staged.c_str());
+      Buffer.Staged.clear();
+      utils::error(std::format("Failed to write '{}': {}", Path,
+                               std::strerror(err)));
+    }
+    Reserved = err == 0;
+  }
+
+  if (Reserved) {
+    /// the file is new, so the reserved range reads as zeroes
+    void* map = ::mmap(nullptr, Size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map != MAP_FAILED) {
+      ::close(fd); // a mapping outlives its descriptor
+
+      Buffer.Data = static_cast<char*>(map);
+      Buffer.Size = Buffer.MappedSize = Size;
+      return Buffer;
+    }
+  }
+
+  Buffer.Owned.resize(Size, '\x00');
+  Buffer.Data = Buffer.Owned.data();
+  Buffer.Size = Size;
+  Buffer.Fd = fd;
+  Buffer.OwnsFd = true;
+
+  return Buffer;
+}
+
+OutputBuffer OutputBuffer::fromFd(int Fd, size_ty Size) {
+  OutputBuffer Buffer;
+
+  Buffer.Owned.resize(Size, '\x00');
+  Buffer.Data = Buffer.Owned.data();
+  Buffer.Size = Size;
+  Buffer.Fd = Fd;
+
+  return Buffer;
+}
+
+void OutputBuffer::discard() {
+  if (isMapped()) {
+    ::munmap(Data, MappedSize);
+  }
+
+  if (OwnsFd) {
+    ::close(Fd);
+  }
+
+  if (!Staged.empty()) {
+    ::unlink(Staged.c_str());
+  }
+
+  Data = nullptr;
+  Size = MappedSize = 0;
+  Fd = -1;
+  OwnsFd = false;
+  Owned.clear();
+  Path.clear();
+  Staged.clear();
+}
+
+void OutputBuffer::commit() {
+  /// a failure below leaves the rest to discard()
+  if (isMapped()) {
+    ::munmap(Data, MappedSize);
+    Data = nullptr;
+    MappedSize = 0;
+  }
+
+  for (size_ty written = 0; Fd >= 0 && written < Owned.size();) {
+    auto n = ::write(Fd, Owned.data() + written, Owned.size() - written);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0) {
+      utils::unreachable("Failed to write file");
+    }
+
+    written += n;
+  }
+
+  if (OwnsFd) {
+    ::close(std::exchange(Fd, -1));
+    OwnsFd = false;
+  }
+
+  if (!Staged.empty()) {
+    if (::rename(Staged.c_str(), Path.c_str()) != 0) {
+      utils::unreachable("Failed to write file");
+    }
+    Staged.clear();
+  }
+
+  discard();
+}
+
+std::vector<char> OutputBuffer::release() {
+  utils_assert(!isMapped() && Fd < 0, "only an in-memory image is released");
+
+  auto Bytes = std::move(Owned);
+  discard();
+
+  return Bytes;
+}
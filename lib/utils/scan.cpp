@@ -0,0 +1,171 @@
+#include "utils/scan.hpp"
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define UTILS_SCAN_X86
+#define UTILS_SCAN_AVX2 __attribute__((target("avx2")))
+#endif
+
+using namespace utils::scan;
+
+namespace {
+enum class Run { Blanks, Digits, Ident, Line };
+
+template <Run R> bool continues(char c) {
+  if constexpr (R == Run::Blanks) {
+    return is(c, kBlank);
+  } else if constexpr (R == Run::Digits) {
+    return is(c, kDigit);
+  } else if constexpr (R == Run::Ident) {
+    return is(c, kIdent);
+  } else {
+    return c != '\n';
+  }
+}
+
+template <Run R> const char* scalar(const char* p, const char* End) {
+  if constexpr (R == Run::Line) {
+    auto Newline = std::memchr(p, '\n', End - p);
+    return Newline ? static_cast<const char*>(Newline) : End;
+  } else {
+    while (p != End && continues<R>(*p)) {
+      ++p;
+    }
+    return p;
+  }
+}
+
+#ifdef UTILS_SCAN_X86
+/// SSE2 is part of x86-64, no dispatch needed for it
+
+/// bytes in [Lo, Hi], as 0xff lanes; signed compares leave out >= 0x80
+__m128i inRange(__m128i v, char Lo, char Hi) {
+  return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(Lo - 1)),
+                       _mm_cmplt_epi8(v, _mm_set1_epi8(Hi + 1)));
+}
+
+/// a bit for each byte that ends the run
+template <Run R> unsigned stops(__m128i v) {
+  auto eq = [&](char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); };
+
+  __m128i Match;
+  if constexpr (R == Run::Blanks) {
+    Match = _mm_or_si128(_mm_or_si128(eq(' '), eq('\t')), eq('\r'));
+  } else if constexpr (R == Run::Digits) {
+    Match = inRange(v, '0', '9');
+  } else if constexpr (R == Run::Ident) {
+    /// setting 0x20 lowers exactly the letters into a-z
+    auto Lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    Match = _mm_or_si128(_mm_or_si128(inRange(v, '0', '9'),
+                                      inRange(Lower, 'a', 'z')),
+                         _mm_or_si128(eq('_'), eq('.')));
+  } else {
+    return static_cast<unsigned>(_mm_movemask_epi8(eq('\n')));
+  }
+
+  return ~static_cast<unsigned>(_mm_movemask_epi8(Match)) & 0xffffu;
+}
+
+template <Run R> const char* sse2(const char* p, const char* End) {
+  for (; End - p >= 16; p += 16) {
+    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    if (auto Bits = stops<R>(v)) {
+      return p + __builtin_ctz(Bits);
+    }
+  }
+  return scalar<R>(p, End);
+}
+
+UTILS_SCAN_AVX2 __m256i inRange(__m256i v, char Lo, char Hi) {
+  return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(Lo - 1)),
+                          _mm256_cmpgt_epi8(_mm256_set1_epi8(Hi + 1), v));
+}
+
+UTILS_SCAN_AVX2 __m256i eq(__m256i v, char c) {
+  return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+}
+
+template <Run R> UTILS_SCAN_AVX2 unsigned stops(__m256i v) {
+  __m256i Match;
+  if constexpr (R == Run::Blanks) {
+    Match = _mm256_or_si256(_mm256_or_si256(eq(v, ' '), eq(v, '\t')),
+                            eq(v, '\r'));
+  } else if constexpr (R == Run::Digits) {
+    Match = inRange(v, '0', '9');
+  } else if constexpr (R == Run::Ident) {
+    auto Lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    Match = _mm256_or_si256(_mm256_or_si256(inRange(v, '0', '9'),
+                                            inRange(Lower, 'a', 'z')),
+                            _mm256_or_si256(eq(v, '_'), eq(v, '.')));
+  } else {
+    return static_cast<unsigned>(_mm256_movemask_epi8(eq(v, '\n')));
+  }
+
+  return ~static_cast<unsigned>(_mm256_movemask_epi8(Match));
+}
+
+template <Run R> UTILS_SCAN_AVX2 const char* avx2(const char* p,
+                                                  const char* End) {
+  for (; End - p >= 32; p += 32) {
+    auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    if (auto Bits = stops<R>(v)) {
+      return p + __builtin_ctz(Bits);
+    }
+  }
+  return sse2<R>(p, End);
+}
+#endif
+
+using Kernel = const char* (*)(const char*, const char*);
+
+struct Kernels {
+  Kernel Blanks, Line, Ident, Digits;
+  const char* Isa;
+};
+
+const Kernels& kernels() {
+  static const Kernels Selected = [] {
+#ifdef UTILS_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      return Kernels{avx2<Run::Blanks>, avx2<Run::Line>, avx2<Run::Ident>,
+                     avx2<Run::Digits>, "avx2"};
+    }
+    return Kernels{sse2<Run::Blanks>, sse2<Run::Line>, sse2<Run::Ident>,
+                   sse2<Run::Digits>, "sse2"};
+#else
+    return Kernels{scalar<Run::Blanks>, scalar<Run::Line>, scalar<Run::Ident>,
+                   scalar<Run::Digits>, "scalar"};
+#endif
+  }();
+  return Selected;
+}
+
+/// most runs are a byte or two (one space, a short mnemonic), those never
+/// pay for the indirect call
+template <Run R> const char* run(Kernel K, const char* Begin, const char* End) {
+  if (Begin == End || !continues<R>(*Begin)) {
+    return Begin;
+  }
+  return K(Begin + 1, End);
+}
+} // namespace
+
+const char* utils::scan::skipBlanks(const char* Begin, const char* End) {
+  return run<Run::Blanks>(kernels().Blanks, Begin, End);
+}
+
+const char* utils::scan::findNewline(const char* Begin, const char* End) {
+  return run<Run::Line>(kernels().Line, Begin, End);
+}
+
+const char* utils::scan::skipIdent(const char* Begin, const char* End) {
+  return run<Run::Ident>(kernels().Ident, Begin, End);
+}
+
+const char* utils::scan::skipDigits(const char* Begin, const char* End) {
+  return run<Run::Digits>(kernels().Digits, Begin, End);
+}
+
+const char* utils::scan::isa() { return kernels().Isa; }
@@ -0,0 +1,162 @@
+#include "utils/source.hpp"
+#include "utils/logger.hpp"
+#include "utils/scan.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace utils;
+
+LineIndex::LineIndex(ADT::StringRef Source) {
+  auto end = Source.data() + Source.size();
+  for (auto p = scan::findNewline(Source.data(), end); p != end;
+       p = scan::findNewline(p + 1, end)) {
+    Starts.push_back(static_cast<std::size_t>(p + 1 - Source.data()));
+  }
+}
+
+Location LineIndex::locate(std::size_t Offset) const {
+  auto line = std::upper_bound(Starts.begin(), Starts.end(), Offset);
+  auto start = line == Starts.begin() ? 0 : *(line - 1);
+  return {static_cast<std::size_t>(line - Starts.begin()) + 1,
+          Offset - start + 1};
+}
+
+SourceBuffer::SourceBuffer(SourceBuffer&& Other) { *this = std::move(Other); }
+
+SourceBuffer& SourceBuffer::operator=(SourceBuffer&& Other) {
+  if (this == &Other) {
+    return *this;
+  }
+
+  release();
+
+  MappedSize = std::exchange(Other.MappedSize, 0);
+  Size = std::exchange(Other.Size, 0);
+  Owned = std::move(Other.Owned);
+  Data = isMapped() ? std::exchange(Other.Data, nullptr) : Owned.data();
+  Other.Data = nullptr;
+
+  return *this;
+}
+
+SourceBuffer::~SourceBuffer() { release(); }
+
+void SourceBuffer::release() {
+  if (isMapped()) {
+    ::munmap(const_cast<char*>(Data), MappedSize);
+  }
+
+  Data = nullptr;
+  Size = MappedSize = 0;
+  Owned.clear();
+}
+
+SourceBuffer SourceBuffer::open(const char* Path) {
+  int fd = ::open(Path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    utils::unreachable("Failed to open file");
+  }
+
+  auto Buffer = fromFd(fd);
+  ::close(fd); // a mapping outlives its descriptor
+
+  return Buffer;
+}
+
+std::optional<SourceBuffer> SourceBuffer::tryOpen(const char* Path) {
+  int fd = ::open(Path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return std::nullopt;
+  }
+
+  struct stat st{};
+  if (::fstat(fd, &st) != 0 || S_ISDIR(st.st_mode)) {
+    ::close(fd);
+    return std::nullopt;
+  }
+
+  auto Buffer = fromFd(fd);
+  ::close(fd);
+
+  return Buffer;
+}
+
+SourceBuffer SourceBuffer::fromFd(int Fd) {
+  SourceBuffer Buffer;
+
+  struct stat st{};
+  if (::fstat(Fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    auto size = static_cast<size_ty>(st.st_size);
+
+    /// lexing is a single forward pass, let the kernel read ahead aggressively
+    ::posix_fadvise(Fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, Fd, 0);
+    if (map != MAP_FAILED) {
+      ::madvise(map, size, MADV_SEQUENTIAL);
+      ::madvise(map, size, MADV_WILLNEED);
+
+      Buffer.Data = static_cast<const char*>(map);
+      Buffer.Size = Buffer.MappedSize = size;
+      return Buffer;
+    }
+    /// e.g. a filesystem without mmap support, read it instead
+  }
+
+  /// pipes, ttys, procfs...: size unknown until EOF
+  std::string& Owned = Buffer.Owned;
+  Owned.resize(S_ISREG(st.st_mode) && st.st_size > 0 ? st.st_size : 64 * 1024);
+
+  size_ty filled = 0;
+  while (true) {
+    if (filled == Owned.size()) {
+      Owned.resize(Owned.size() * 2);
+    }
+
+    auto n = ::read(Fd, Owned.data() + filled, Owned.size() - filled);
+    if (n == 0) {
+      break;
+    } else if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      utils::unreachable("Failed to read file");
+    }
+
+    filled += n;
+  }
+
+  Owned.resize(filled);
+  Buffer.Data = Owned.data();
+  Buffer.Size = filled;
+
+  return Buffer;
+}
+
+SourceStream::size_ty SourceStream::readInto(std::string& Buf, size_ty Max) {
+  if (Eof) {
+    return 0;
+  }
+
+  auto filled = Buf.size();
+  Buf.resize(filled + Max);
+
+  while (true) {
+    auto n = ::read(Fd, Buf.data() + filled, Max);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0) {
+      utils::unreachable("Failed to read file");
+    }
+
+    Buf.resize(filled + n);
+    Eof = n == 0;
+
+    return n;
+  }
+}
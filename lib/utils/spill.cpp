@@ -0,0 +1,96 @@
+#include "utils/spill.hpp"
+#include "utils/logger.hpp"
+#include "utils/macro.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+using namespace utils;
+
+SpillBuffer::~SpillBuffer() {
+  if (Fd >= 0) {
+    ::close(Fd);
+  }
+}
+
+void SpillBuffer::spill() {
+  if (Fd < 0) {
+    auto* dir = std::getenv("TMPDIR");
+    auto path = std::string(dir && *dir ? dir : "/tmp") + "/rvasm-XXXXXX";
+
+    Fd = ::mkstemp(path.data());
+    utils_assert(Fd >= 0, "can't create a file to spill .text into");
+    /// gone with the descriptor, whatever happens to the process
+    ::unlink(path.c_str());
+  }
+
+  for (size_ty done = 0; done < Tail.size();) {
+    auto n = ::pwrite(Fd, Tail.data() + done, Tail.size() - done,
+                      Spilled + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    utils_assert(n > 0, "failed to spill .text");
+    done += n;
+  }
+
+  Spilled += Tail.size();
+  Tail.clear();
+}
+
+void SpillBuffer::append(const void* Data, size_ty N) {
+  auto bytes = static_cast<const char*>(Data);
+  Tail.insert(Tail.end(), bytes, bytes + N);
+
+  if (Tail.size() >= Limit) {
+    spill();
+  }
+}
+
+void SpillBuffer::write(size_ty Offset, const void* Data, size_ty N) {
+  utils_assert(Offset + N <= size(), "writing past the buffer");
+
+  auto bytes = static_cast<const char*>(Data);
+
+  /// the part still in memory
+  if (Offset + N > Spilled) {
+    auto skip = Offset < Spilled ? Spilled - Offset : 0;
+    std::memcpy(Tail.data() + (Offset + skip - Spilled), bytes + skip,
+                N - skip);
+    N = skip;
+  }
+
+  for (size_ty done = 0; done < N;) {
+    auto n = ::pwrite(Fd, bytes + done, N - done, Offset + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    utils_assert(n > 0, "failed to patch spilled .text");
+    done += n;
+  }
+}
+
+void SpillBuffer::read(size_ty Offset, void* Out, size_ty N) const {
+  utils_assert(Offset + N <= size(), "reading past the buffer");
+
+  auto bytes = static_cast<char*>(Out);
+
+  for (size_ty done = 0; Offset + done < Spilled && done < N;) {
+    auto want = std::min(N - done, Spilled - Offset - done);
+    auto n = ::pread(Fd, bytes + done, want, Offset + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    utils_assert(n > 0, "failed to read spilled .text back");
+    done += n;
+  }
+
+  if (Offset + N > Spilled) {
+    auto skip = Offset < Spilled ? Spilled - Offset : 0;
+    std::memcpy(bytes + skip, Tail.data() + (Offset + skip - Spilled),
+                N - skip);
+  }
+}
@@ -0,0 +1,99 @@
+#! /usr/bin/env python3
+
+# objects served or stitched from the cache must match uncached builds
+#
+#   ./test_cache.py [assembler] [--table <assembler>]
+#
+# every test_custom input is assembled without the cache, then twice with
+# it (a miss, then a hit); 10.fragments.s is assembled once more with one
+# function edited, the others replayed from their fragments. --table
+# compares against a build configured with -DENABLE_TABLE_LEXER=ON
+
+import filecmp
+import os
+import subprocess
+import tempfile
+from sys import argv
+
+TEST_CUSTOM_DIR = "./test_custom"
+FRAGMENTS_FILE = "10.fragments.s"
+
+args = argv[1:]
+TABLE_ASSEMBLER_PATH = None
+if "--table" in args:
+  at = args.index("--table")
+  TABLE_ASSEMBLER_PATH = args[at + 1]
+  del args[at:at + 2]
+ASSEMBLER_PATH = args[0] if args else "./build/assembler"
+
+
+def assemble(source, obj, cache=None, assembler=ASSEMBLER_PATH):
+  cmd = [assembler, "-c", source, "-o", obj]
+  if cache:
+    cmd += ["--cache", cache]
+  subprocess.run(cmd, check=True, stdout=True)
+
+
+def hits(cache):
+  stats = subprocess.run([ASSEMBLER_PATH, "--cache", cache, "--cache-stats"],
+                         check=True, capture_output=True, text=True).stdout
+  return int(stats.split()[1])
+
+
+def expect(ok, what):
+  if not ok:
+    print(f"[!] {what}")
+    exit(-1)
+  print(f"[+] {what}")
+
+
+with tempfile.TemporaryDirectory() as tmp:
+  cache = os.path.join(tmp, "cache")
+  sources = sorted(f for f in os.listdir(TEST_CUSTOM_DIR) if f.endswith(".s"))
+
+  for file in sources:
+    source = os.path.join(TEST_CUSTOM_DIR, file)
+    plain = os.path.join(tmp, file + ".plain.o")
+    cold = os.path.join(tmp, file + ".cold.o")
+    warm = os.path.join(tmp, file + ".warm.o")
+
+    assemble(source, plain)
+    assemble(source, cold, cache)
+    before = hits(cache)
+    assemble(source, warm, cache)
+
+    expect(filecmp.cmp(plain, cold, shallow=False),
+           f"{file}: a cache miss matches the uncached object")
+    expect(filecmp.cmp(plain, warm, shallow=False),
+           f"{file}: a cache hit matches the uncached object")
+    # .incbin pulls in other files, such objects are never stored
+    with open(source) as f:
+      cached = ".incbin" not in f.read().lower()
+    expect(hits(cache) == before + cached,
+           f"{file}: the second run {'hits' if cached else 'misses'}")
+
+    if TABLE_ASSEMBLER_PATH:
+      table = os.path.join(tmp, file + ".table.o")
+      assemble(source, table, assembler=TABLE_ASSEMBLER_PATH)
+      expect(filecmp.cmp(plain, table, shallow=False),
+             f"{file}: the table lexer matches the default lexer")
+
+  expect(os.listdir(os.path.join(cache, "fragments")),
+         "functions were recorded as fragments")
+
+  # helper gains a .L<N>, so bump comes back renumbered
+  with open(os.path.join(TEST_CUSTOM_DIR, FRAGMENTS_FILE)) as f:
+    original = f.read()
+  edited = original.replace("\tli a0, 1\n", "\tla a0, counter\n")
+  assert edited != original, "the line to edit is gone"
+  source = os.path.join(tmp, FRAGMENTS_FILE)
+  with open(source, "w") as f:
+    f.write(edited)
+
+  plain = os.path.join(tmp, "edited.plain.o")
+  stitched = os.path.join(tmp, "edited.cached.o")
+  assemble(source, plain)
+  assemble(source, stitched, cache)
+  expect(filecmp.cmp(plain, stitched, shallow=False),
+         f"{FRAGMENTS_FILE}: an edited function among replayed ones matches "
+         "the uncached object")
@@ -0,0 +1,40 @@
+.bss
+.data
+.globl counter
+counter:
+	.dword 0
+.text
+# every .globl starts a function the fragment cache keeps on its own,
+# la/ld <sym> build .L<N> labels that are renumbered on replay
+.globl main
+main:
+	la a0, counter
+	ld a1, counter
+	call helper
+	beqz a0, main_0
+	call bump
+main_0:
+	ret
+
+# .L2 is taken by the source, so the .L<N> the la below builds collides:
+# the function is never cached, it is parsed on every run
+.globl clash
+clash:
+.L2:
+	la a3, counter
+	ret
+
+.globl helper
+helper:
+	la a2, counter
+	li a0, 1
+	ret
+
+.globl bump
+bump:
+	ld a0, counter
+	addi a0, a0, 1
+	bnez a0, bump_0
+	j clash
+bump_0:
+	ret
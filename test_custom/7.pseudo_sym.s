@@ -0,0 +1,21 @@
+.data
+.globl gv
+gv:
+	.dword 0
+hv:
+	.word 0
+.text
+.globl main
+main:
+# load and store through a data symbol
+	lb a0, gv
+	lh a0, gv
+	lw a0, hv
+	ld a0, gv
+	sb a0, gv, t0
+	sh a0, hv, t1
+	sw a0, hv, t1
+	sd a0, gv, t0
+	sd a1, hv, t2
+	la a2, gv
+	ret
@@ -0,0 +1,6 @@
+.text
+.globl main
+main:
+	addi a0, zero, 1
+	call main
+	sd a0, main, t0
\ No newline at end of file
@@ -0,0 +1,36 @@
+.data
+.globl table
+table:
+# value lists
+	.half 1, 2, 0x3
+	.word 4, 0x5, 6, 7
+	.dword 8, 0x9
+# .space/.zero size[, byte] and .fill repeat[, size[, value]]
+pad:
+	.space 3
+	.space 5, 0xaa
+	.zero 4
+	.fill 3
+	.fill 2, 4, 0x12345678
+	.fill 2, 8, 0xdeadbeef
+	.balign 8
+# .incbin "file"[, skip[, count]], relative to this file
+blob:
+	.incbin "9.data.bin"
+	.incbin "9.data.bin", 5
+	.incbin "9.data.bin", 5, 4
+	.align 3
+# .zero/.space in .bss reserve their size, no fill value
+.bss
+.globl buf
+buf:
+	.zero 16
+	.space 8
+.text
+.globl main
+main:
+	la a0, table
+	la a1, pad
+	la a2, blob
+	la a3, buf
+	ret